@@ -44,10 +44,21 @@ private:
 
 void Escapes(const UriString & uri) {
 	const URI_CHAR * first = uri.c_str();
-	// Up to 6 bytes per character with normalizeBreaks enabled (\n -> %0D%0A)
-	std::vector<URI_CHAR> buf1(uri.size() * 6 + 1);
-	// and up to 3 bytes per character otherwise
-	std::vector<URI_CHAR> buf2(uri.size() * 3 + 1);
+	const URI_CHAR * afterLast = first + uri.size();
+	int charsRequired;
+
+	// Exact size with normalizeBreaks enabled (\n -> %0D%0A)
+	if (URI_FUNC(EscapeCharsRequired)(first, afterLast, URI_FALSE, URI_TRUE,
+			&charsRequired) != URI_SUCCESS) {
+		return;
+	}
+	std::vector<URI_CHAR> buf1(charsRequired + 1);
+	// and otherwise
+	if (URI_FUNC(EscapeCharsRequired)(first, afterLast, URI_FALSE, URI_FALSE,
+			&charsRequired) != URI_SUCCESS) {
+		return;
+	}
+	std::vector<URI_CHAR> buf2(charsRequired + 1);
 
 	URI_CHAR * result;
 	result = URI_FUNC(Escape)(first, &buf1[0], URI_TRUE, URI_TRUE);
@@ -143,6 +143,14 @@ typedef struct URI_TYPE(HostDataStruct) {
  * Represents an RFC 3986 %URI.
  * Missing components can be {NULL, NULL} ranges.
  *
+ * Since 0.9.9, an owner %URI may keep the text of all of its components,
+ * and possibly its path segment nodes and binary host data, in a single
+ * block referenced by <c>reserved</c> (e.g. after uriNormalizeSyntaxA,
+ * uriMakeOwnerA or uriCopyUriA).  Text of a single component of an owner
+ * %URI must therefore not be freed or replaced individually, and
+ * <c>reserved</c> must be NULL for any %URI not made by uriparser,
+ * e.g. a structure set up by hand; uriFreeUriMembersA releases the block.
+ *
  * @see uriFreeUriMembersA
  * @see uriFreeUriMembersMmA
  * @see UriParserStateA
@@ -162,11 +170,29 @@ typedef struct URI_TYPE(UriStruct) {
 								always <c>URI_FALSE</c> for URIs with host */
 	UriBool owner; /**< Memory owner flag */
 
-	void * reserved; /**< Reserved to the parser */
+	void * reserved; /**< Reserved to the library, single block of memory owned or NULL */
 } URI_TYPE(Uri); /**< @copydoc UriUriStructA */
 
 
 
+/**
+ * Immutable, reference-counted %URI living in a single allocation,
+ * made by uriFreezeUriMmA.  The %URI may be read from several threads
+ * at the same time but must never be modified.
+ * Members other than <c>uri</c> should be considered private.
+ *
+ * @see uriFreezeUriMmA
+ * @see uriFrozenUriRetainA
+ * @see uriFrozenUriReleaseMmA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(FrozenUriStruct) {
+	URI_TYPE(Uri) uri; /**< Frozen %URI, read-only */
+	long refCount; /**< Number of references, changed atomically */
+} URI_TYPE(FrozenUri); /**< @copydoc UriFrozenUriStructA */
+
+
+
 /**
  * Represents a state of the %URI parser.
  * Missing components can be NULL to reflect
@@ -202,6 +228,210 @@ typedef struct URI_TYPE(QueryListStruct) {
 
 
 
+/**
+ * Represents a query element by ranges rather than terminated strings.
+ * Ranges can point into any existing buffer and are never owned
+ * by the list itself, so no copies are needed to build one.
+ *
+ * @see uriComposeQueryRangeListExA
+ * @see uriDissectQueryRangeListMallocExA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(QueryRangeListStruct) {
+	URI_TYPE(TextRange) key; /**< Key of the query element, first can be NULL for an empty key */
+	URI_TYPE(TextRange) value; /**< Value of the query element, first is NULL if there is no value */
+
+	struct URI_TYPE(QueryRangeListStruct) * next; /**< Pointer to the next key/value pair in the list, can be NULL if last already */
+} URI_TYPE(QueryRangeList); /**< @copydoc UriQueryRangeListStructA */
+
+
+
+/**
+ * Cursor walking the items of a raw query string
+ * without allocating or unescaping anything.
+ * Members should be considered private.
+ *
+ * @see uriQueryIteratorInitA
+ * @see uriQueryIteratorNextA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(QueryIteratorStruct) {
+	const URI_CHAR * next; /**< Start of the next item to look at, NULL when exhausted */
+	const URI_CHAR * afterLast; /**< Pointer to character after the last one still in */
+} URI_TYPE(QueryIterator); /**< @copydoc UriQueryIteratorStructA */
+
+
+
+/**
+ * Precompiled set of query keys to look up in a single pass
+ * over a raw query string.  Members should be considered private.
+ *
+ * @see uriQueryKeySetInitA
+ * @see uriQueryIteratorFindKeySetA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(QueryKeySetStruct) {
+	const URI_CHAR * const * keys; /**< Unescaped zero-terminated keys to look for */
+	int keyCount; /**< Number of keys */
+	unsigned int hashes[URI_QUERY_KEY_SET_MAX_KEYS]; /**< Hash per key */
+	unsigned char slots[URI_QUERY_KEY_SET_SLOTS]; /**< Key index plus one per hash slot, zero if free */
+} URI_TYPE(QueryKeySet); /**< @copydoc UriQueryKeySetStructA */
+
+
+
+/**
+ * Dissected query with a hash index over its keys,
+ * living in a single allocation.
+ * Members other than <c>items</c> and <c>itemCount</c>
+ * should be considered private.
+ *
+ * @see uriQueryMapMallocExMmA
+ * @see uriQueryMapFindA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(QueryMapStruct) {
+	URI_TYPE(QueryList) * items; /**< All items in query order as an array, linked through <c>next</c> as well */
+	int itemCount; /**< Number of items */
+	int slotCount; /**< Number of hash slots, a power of two */
+	int * slots; /**< Index plus one of the first item per hash slot, zero if free */
+	int * sameKeyNext; /**< Index plus one of the next item with the same key per item, zero if none */
+	unsigned int * hashes; /**< Key hash per item */
+	int * keyLengths; /**< Length of the unescaped key per item, which may contain NUL characters */
+} URI_TYPE(QueryMap); /**< @copydoc UriQueryMapStructA */
+
+
+
+/**
+ * Function signature that query item callbacks must conform to.
+ * Receives the unescaped zero-terminated key and value of an item;
+ * value is NULL for items without '='.  Both strings are only valid
+ * during the call.  Returning anything but 0 stops decoding:
+ * the value becomes the decoder's error, no further items are passed
+ * and it is returned by all later feed calls and on finish.
+ *
+ * @see uriQueryDecoderInitMmA
+ * @since 0.9.9
+ */
+typedef int (*URI_TYPE(QueryItemCallback))(void * userData,
+		const URI_CHAR * key, const URI_CHAR * value);
+
+
+
+/**
+ * Push parser for query strings and
+ * application/x-www-form-urlencoded bodies arriving in chunks.
+ * Members should be considered private.
+ *
+ * @see uriQueryDecoderInitMmA
+ * @see uriQueryDecoderFeedA
+ * @see uriQueryDecoderFinishA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(QueryDecoderStruct) {
+	URI_CHAR * buffer; /**< Raw text of the item in progress */
+	size_t length; /**< Number of characters in buffer */
+	size_t capacity; /**< Number of characters buffer can hold */
+	size_t keyLength; /**< Offset of the first '=' in buffer, if any */
+	UriBool separatorSeen; /**< Whether buffer contains '=' */
+	UriBool plusToSpace; /**< Whether to convert '+' to ' ' or not */
+	UriBreakConversion breakConversion; /**< Line break conversion mode */
+	URI_TYPE(QueryItemCallback) callback; /**< Callback receiving items */
+	void * userData; /**< Passed to callback as is */
+	UriMemoryManager * memory; /**< Memory manager to use */
+	int error; /**< Sticky error or callback result, 0 if none */
+} URI_TYPE(QueryDecoder); /**< @copydoc UriQueryDecoderStructA */
+
+
+
+/**
+ * Composes a query string item by item right into a buffer,
+ * either one owned by the caller or one grown as needed.
+ * Members <c>buffer</c>, <c>length</c> and <c>itemCount</c> may be read,
+ * all members should be considered read-only.
+ *
+ * @see uriQueryBuilderInitA
+ * @see uriQueryBuilderInitMmA
+ * @see uriQueryBuilderAppendA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(QueryBuilderStruct) {
+	URI_CHAR * buffer; /**< Query composed so far, zero-terminated, NULL before the first item with a managed buffer */
+	size_t length; /**< Number of characters in buffer excluding terminator */
+	size_t capacity; /**< Number of characters buffer can hold including terminator */
+	size_t itemCount; /**< Number of items appended so far */
+	UriBool spaceToPlus; /**< Whether to convert ' ' to '+' or not */
+	UriBool normalizeBreaks; /**< Whether to convert CR and LF to CR-LF or not */
+	UriMemoryManager * memory; /**< Memory manager to grow buffer with, NULL for a caller-owned buffer */
+} URI_TYPE(QueryBuilder); /**< @copydoc UriQueryBuilderStructA */
+
+
+
+/**
+ * Function signature that text sinks of streaming escape and unescape
+ * must conform to.  Receives the next piece of output, which is only
+ * valid during the call.  A non-zero return value aborts the stream
+ * and is passed on as its error code.
+ *
+ * @see uriEscapeStreamInitA
+ * @see uriUnescapeStreamInitA
+ * @since 0.9.9
+ */
+typedef int (*URI_TYPE(TextSink))(void * userData,
+		const URI_CHAR * first, const URI_CHAR * afterLast);
+
+
+
+/**
+ * Percent-encoder for input arriving in chunks, writing its output
+ * through a fixed window buffer to a text sink.
+ * Members should be considered private.
+ *
+ * @see uriEscapeStreamInitA
+ * @see uriEscapeStreamFeedA
+ * @see uriEscapeStreamFinishA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(EscapeStreamStruct) {
+	URI_CHAR * window; /**< Output not yet passed to the sink */
+	size_t windowChars; /**< Number of characters window can hold */
+	size_t fill; /**< Number of characters in window */
+	URI_TYPE(TextSink) sink; /**< Sink receiving output */
+	void * userData; /**< Passed to sink as is */
+	UriEscapeMode mode; /**< Characters to keep literally */
+	UriBool spaceToPlus; /**< Whether to convert ' ' to '+' or not */
+	UriBool normalizeBreaks; /**< Whether to convert CR and LF to CR-LF or not */
+	UriBool prevWasCr; /**< Whether the last character fed was CR */
+	int error; /**< Sticky error or callback result, 0 if none */
+} URI_TYPE(EscapeStream); /**< @copydoc UriEscapeStreamStructA */
+
+
+
+/**
+ * Percent-decoder for input arriving in chunks, writing its output
+ * through a fixed window buffer to a text sink.
+ * Members should be considered private.
+ *
+ * @see uriUnescapeStreamInitA
+ * @see uriUnescapeStreamFeedA
+ * @see uriUnescapeStreamFinishA
+ * @since 0.9.9
+ */
+typedef struct URI_TYPE(UnescapeStreamStruct) {
+	URI_CHAR * window; /**< Output not yet passed to the sink */
+	size_t windowChars; /**< Number of characters window can hold */
+	size_t fill; /**< Number of characters in window */
+	URI_TYPE(TextSink) sink; /**< Sink receiving output */
+	void * userData; /**< Passed to sink as is */
+	UriBool plusToSpace; /**< Whether to convert '+' to ' ' or not */
+	UriBreakConversion breakConversion; /**< Line break conversion mode */
+	UriBool prevWasCr; /**< Whether the last character written was a decoded CR */
+	URI_CHAR pending[2]; /**< Start of a percent group cut off by the end of a chunk */
+	int pendingCount; /**< Number of characters in pending */
+	int error; /**< Sticky error or callback result, 0 if none */
+} URI_TYPE(UnescapeStream); /**< @copydoc UriUnescapeStreamStructA */
+
+
+
 /**
  * Parses a RFC 3986 %URI.
  * Uses default libc-based memory manager.
@@ -321,6 +551,8 @@ URI_PUBLIC int URI_FUNC(ParseSingleUriExMm)(URI_TYPE(Uri) * uri,
  * Frees all memory associated with the members
  * of the %URI structure. Note that the structure
  * itself is not freed, only its members.
+ * Member <c>reserved</c> must be NULL unless set by uriparser,
+ * see UriUriA.
  * Uses default libc-based memory manager.
  *
  * @param uri   <b>INOUT</b>: %URI structure whose members should be freed
@@ -349,14 +581,39 @@ URI_PUBLIC int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri,
 
 
 
+/**
+ * Calculates the exact number of characters uriEscapeExA would write
+ * for the given input, <b>excluding</b> the terminator.
+ * Like uriEscapeExA, counting stops at a NUL character
+ * even when <c>inAfterLast</c> is given.
+ *
+ * @param inFirst           <b>IN</b>: Pointer to first character of the input text
+ * @param inAfterLast       <b>IN</b>: Pointer after the last character of the input text, NULL if the input is zero-terminated
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @param charsRequired     <b>OUT</b>: Length of the escaped text in characters <b>excluding</b> terminator
+ * @return                  Error code or 0 on success
+ *
+ * @see uriEscapeExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(EscapeCharsRequired)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, UriBool spaceToPlus,
+		UriBool normalizeBreaks, int * charsRequired);
+
+
+
 /**
  * Percent-encodes all but unreserved characters from the input string and
  * writes the encoded version to the output string.
  *
- * NOTE: Be sure to allocate <b>3 times</b> the space of the input buffer for
- * the output buffer for <c>normalizeBreaks == URI_FALSE</c> and <b>6 times</b>
+ * NOTE: Be sure to allocate enough space for the output buffer:
+ * uriEscapeCharsRequiredA tells the exact number of characters needed,
+ * otherwise allocate <b>3 times</b> the space of the input buffer for
+ * <c>normalizeBreaks == URI_FALSE</c> and <b>6 times</b>
  * the space for <c>normalizeBreaks == URI_TRUE</c>
- * (since e.g. "\x0d" becomes "%0D%0A" in that case).
+ * (since e.g. "\x0d" becomes "%0D%0A" in that case),
+ * plus one for the terminator.
  *
  * NOTE: The implementation treats (both <c>char</c> and) <c>wchar_t</c> units
  * as code point integers, which works well for code points <c>U+0001</c> to <c>U+00ff</c>
@@ -374,6 +631,7 @@ URI_PUBLIC int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri,
  * @return                  Position of terminator in output string
  *
  * @see uriEscapeA
+ * @see uriEscapeCharsRequiredA
  * @see uriUnescapeInPlaceExA
  * @since 0.5.2
  */
@@ -387,10 +645,13 @@ URI_PUBLIC URI_CHAR * URI_FUNC(EscapeEx)(const URI_CHAR * inFirst,
  * Percent-encodes all but unreserved characters from the input string and
  * writes the encoded version to the output string.
  *
- * NOTE: Be sure to allocate <b>3 times</b> the space of the input buffer for
- * the output buffer for <c>normalizeBreaks == URI_FALSE</c> and <b>6 times</b>
+ * NOTE: Be sure to allocate enough space for the output buffer:
+ * uriEscapeCharsRequiredA tells the exact number of characters needed,
+ * otherwise allocate <b>3 times</b> the space of the input buffer for
+ * <c>normalizeBreaks == URI_FALSE</c> and <b>6 times</b>
  * the space for <c>normalizeBreaks == URI_TRUE</c>
- * (since e.g. "\x0d" becomes "%0D%0A" in that case).
+ * (since e.g. "\x0d" becomes "%0D%0A" in that case),
+ * plus one for the terminator.
  *
  * NOTE: The implementation treats (both <c>char</c> and) <c>wchar_t</c> units
  * as code point integers, which works well for code points <c>U+0001</c> to <c>U+00ff</c>
@@ -415,6 +676,58 @@ URI_PUBLIC URI_CHAR * URI_FUNC(Escape)(const URI_CHAR * in, URI_CHAR * out,
 
 
 
+/**
+ * Calculates the exact number of characters uriEscapeComponentA would write
+ * for the given input and mode, <b>excluding</b> the terminator.
+ *
+ * @param inFirst           <b>IN</b>: Pointer to first character of the input text
+ * @param inAfterLast       <b>IN</b>: Pointer after the last character of the input text, NULL if the input is zero-terminated
+ * @param mode              <b>IN</b>: %URI component the text is meant for
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @param charsRequired     <b>OUT</b>: Length of the escaped text in characters <b>excluding</b> terminator
+ * @return                  Error code or 0 on success
+ *
+ * @see uriEscapeComponentA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(EscapeComponentCharsRequired)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, UriEscapeMode mode,
+		UriBool spaceToPlus, UriBool normalizeBreaks, int * charsRequired);
+
+
+
+/**
+ * Percent-encodes the input string for use in a particular %URI component,
+ * keeping all characters literally that the component allows,
+ * and writes the encoded version to the output string.
+ * With #URI_ESCAPE_UNRESERVED the result matches uriEscapeExA.
+ * Unknown modes are treated like #URI_ESCAPE_UNRESERVED.
+ * <c>spaceToPlus</c> is ignored for modes that keep '+' literally,
+ * i.e. all but #URI_ESCAPE_UNRESERVED and #URI_ESCAPE_QUERY_PARAM.
+ *
+ * NOTE: Be sure to allocate enough space for the output buffer:
+ * uriEscapeComponentCharsRequiredA tells the exact number of
+ * characters needed, plus one for the terminator.
+ *
+ * @param inFirst           <b>IN</b>: Pointer to first character of the input text
+ * @param inAfterLast       <b>IN</b>: Pointer after the last character of the input text, NULL if the input is zero-terminated
+ * @param out               <b>OUT</b>: Encoded text destination
+ * @param mode              <b>IN</b>: %URI component the text is meant for
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @return                  Position of terminator in output string
+ *
+ * @see uriEscapeExA
+ * @see uriEscapeComponentCharsRequiredA
+ * @since 0.9.9
+ */
+URI_PUBLIC URI_CHAR * URI_FUNC(EscapeComponent)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out, UriEscapeMode mode,
+		UriBool spaceToPlus, UriBool normalizeBreaks);
+
+
+
 /**
  * Unescapes percent-encoded groups in a given string.
  * E.g. "%20" will become " ". Unescaping is done in place.
@@ -459,6 +772,209 @@ URI_PUBLIC const URI_CHAR * URI_FUNC(UnescapeInPlace)(URI_CHAR * inout);
 
 
 
+/**
+ * Unescapes percent-encoded groups in a given range of text,
+ * e.g. "%20" will become " ", see uriUnescapeRangeExA.
+ * '+' and line breaks are left alone.
+ *
+ * @param inFirst       <b>IN</b>: Pointer to first character of the input text
+ * @param inAfterLast   <b>IN</b>: Pointer after the last character of the input text
+ * @param out           <b>OUT</b>: Decoded text destination, room for <c>inAfterLast - inFirst</c> characters, can be <c>inFirst</c>
+ * @param result        <b>OUT</b>: Range of the decoded text, either within <c>out</c> or the input itself
+ * @return              Error code or 0 on success
+ *
+ * @see uriUnescapeRangeExA
+ * @see uriUnescapeInPlaceA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(UnescapeRange)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out,
+		URI_TYPE(TextRange) * result);
+
+
+
+/**
+ * Unescapes percent-encoded groups in a given range of text,
+ * e.g. "%20" will become " ".  Unlike uriUnescapeInPlaceExA, the
+ * input needs no terminator and may contain NUL characters.
+ * Runs of text without escapes are moved in bulk.
+ * If nothing needs decoding, <c>out</c> is left untouched and
+ * <c>result</c> is set to the input range so that the copy can be skipped;
+ * otherwise <c>result</c> covers the decoded text starting at <c>out</c>.
+ * No terminator is written.
+ *
+ * @param inFirst           <b>IN</b>: Pointer to first character of the input text
+ * @param inAfterLast       <b>IN</b>: Pointer after the last character of the input text
+ * @param out               <b>OUT</b>: Decoded text destination, room for <c>inAfterLast - inFirst</c> characters, can be <c>inFirst</c> to decode in place
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @param result            <b>OUT</b>: Range of the decoded text, either within <c>out</c> or the input itself
+ * @return                  Error code or 0 on success
+ *
+ * @see uriUnescapeRangeA
+ * @see uriUnescapeInPlaceExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(UnescapeRangeEx)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		URI_TYPE(TextRange) * result);
+
+
+
+#ifdef URI_PASS_ANSI
+/**
+ * Unescapes percent-encoded groups in a given range of text like
+ * uriUnescapeRangeExA does and, in the same pass, checks that the
+ * decoded text is valid UTF-8: overlong forms, surrogates and code
+ * points above U+10FFFF are rejected as well as truncated sequences.
+ * With <c>replaceInvalid</c>, each maximal invalid subsequence is
+ * replaced by U+FFFD (encoded as "\xEF\xBF\xBD") instead,
+ * which may make the output longer than the input.
+ * Only available for <c>char</c>.
+ *
+ * @param inFirst           <b>IN</b>: Pointer to first character of the input text
+ * @param inAfterLast       <b>IN</b>: Pointer after the last character of the input text
+ * @param out               <b>OUT</b>: Decoded text destination, room for <c>inAfterLast - inFirst</c> characters, can be <c>inFirst</c> to decode in place; with <c>replaceInvalid</c> a separate buffer with room for <c>3 * (inAfterLast - inFirst)</c> characters, <c>inFirst</c> is rejected
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @param replaceInvalid    <b>IN</b>: Whether to replace invalid sequences rather than fail
+ * @param result            <b>OUT</b>: Range of the decoded text, either within <c>out</c> or the input itself
+ * @param errorPos          <b>OUT</b>: Pointer to the first input character of the first invalid sequence, NULL if the text is valid, can be NULL
+ * @return                  Error code or 0 on success, #URI_ERROR_SYNTAX for invalid UTF-8 without <c>replaceInvalid</c>, #URI_ERROR_RANGE_INVALID for <c>out</c> equal to <c>inFirst</c> with <c>replaceInvalid</c>
+ *
+ * @see uriUnescapeRangeExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(UnescapeRangeUtf8)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriBool replaceInvalid, URI_TYPE(TextRange) * result,
+		const URI_CHAR ** errorPos);
+#endif
+
+
+
+/**
+ * Prepares a percent-encoder that accepts input in chunks of any size
+ * and produces the same output as uriEscapeComponentA would for the
+ * concatenated input, except that NUL characters are encoded as "%00"
+ * rather than ending the input.  Output is collected in <c>window</c>
+ * and passed to <c>sink</c> whenever the window is full, so memory use
+ * is constant regardless of input size.
+ *
+ * @param stream            <b>OUT</b>: Stream to initialize
+ * @param window            <b>IN</b>: Buffer to collect output in, owned by the caller
+ * @param windowChars       <b>IN</b>: Number of characters <c>window</c> can hold, at least 1
+ * @param sink              <b>IN</b>: Function receiving output
+ * @param userData          <b>IN</b>: Passed to sink as is
+ * @param mode              <b>IN</b>: %URI component the text is meant for
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @return                  Error code or 0 on success
+ *
+ * @see uriEscapeStreamFeedA
+ * @see uriEscapeStreamFinishA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(EscapeStreamInit)(URI_TYPE(EscapeStream) * stream,
+		URI_CHAR * window, int windowChars, URI_TYPE(TextSink) sink,
+		void * userData, UriEscapeMode mode, UriBool spaceToPlus,
+		UriBool normalizeBreaks);
+
+
+
+/**
+ * Passes the next chunk of input to a percent-encoder.
+ * Once an error has occurred, the stream keeps returning that error.
+ *
+ * @param stream      <b>INOUT</b>: Stream set up by uriEscapeStreamInitA
+ * @param first       <b>IN</b>: Pointer to first character of the chunk
+ * @param afterLast   <b>IN</b>: Pointer to character after the last one still in
+ * @return            Error code or 0 on success
+ *
+ * @see uriEscapeStreamFinishA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(EscapeStreamFeed)(URI_TYPE(EscapeStream) * stream,
+		const URI_CHAR * first, const URI_CHAR * afterLast);
+
+
+
+/**
+ * Signals the end of input to a percent-encoder and passes
+ * the remaining output to the sink.
+ *
+ * @param stream   <b>INOUT</b>: Stream set up by uriEscapeStreamInitA
+ * @return         Error code or 0 on success
+ *
+ * @see uriEscapeStreamFeedA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(EscapeStreamFinish)(URI_TYPE(EscapeStream) * stream);
+
+
+
+/**
+ * Prepares a percent-decoder that accepts input in chunks of any size
+ * and produces the same output as uriUnescapeRangeExA would for the
+ * concatenated input, including percent groups split across chunks.
+ * Output is collected in <c>window</c> and passed to <c>sink</c>
+ * whenever the window is full, so memory use is constant
+ * regardless of input size.
+ *
+ * @param stream            <b>OUT</b>: Stream to initialize
+ * @param window            <b>IN</b>: Buffer to collect output in, owned by the caller
+ * @param windowChars       <b>IN</b>: Number of characters <c>window</c> can hold, at least 1
+ * @param sink              <b>IN</b>: Function receiving output
+ * @param userData          <b>IN</b>: Passed to sink as is
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @return                  Error code or 0 on success
+ *
+ * @see uriUnescapeStreamFeedA
+ * @see uriUnescapeStreamFinishA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(UnescapeStreamInit)(URI_TYPE(UnescapeStream) * stream,
+		URI_CHAR * window, int windowChars, URI_TYPE(TextSink) sink,
+		void * userData, UriBool plusToSpace,
+		UriBreakConversion breakConversion);
+
+
+
+/**
+ * Passes the next chunk of input to a percent-decoder.
+ * Once an error has occurred, the stream keeps returning that error.
+ *
+ * @param stream      <b>INOUT</b>: Stream set up by uriUnescapeStreamInitA
+ * @param first       <b>IN</b>: Pointer to first character of the chunk
+ * @param afterLast   <b>IN</b>: Pointer to character after the last one still in
+ * @return            Error code or 0 on success
+ *
+ * @see uriUnescapeStreamFinishA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(UnescapeStreamFeed)(URI_TYPE(UnescapeStream) * stream,
+		const URI_CHAR * first, const URI_CHAR * afterLast);
+
+
+
+/**
+ * Signals the end of input to a percent-decoder and passes the
+ * remaining output to the sink, including an incomplete percent group
+ * at the very end as is.
+ *
+ * @param stream   <b>INOUT</b>: Stream set up by uriUnescapeStreamInitA
+ * @return         Error code or 0 on success
+ *
+ * @see uriUnescapeStreamFeedA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(UnescapeStreamFinish)(URI_TYPE(UnescapeStream) * stream);
+
+
+
 /**
  * Performs reference resolution as described in
  * <a href="https://datatracker.ietf.org/doc/html/rfc3986#section-5.2.2">section 5.2.2 of RFC 3986</a>.
@@ -608,7 +1124,8 @@ URI_PUBLIC UriBool URI_FUNC(EqualsUri)(const URI_TYPE(Uri) * a,
 /**
  * Calculates the number of characters needed to store the
  * string representation of the given %URI excluding the
- * terminator.
+ * terminator.  For a frozen %URI (see uriFreezeUriMmA)
+ * the length is cached and returned without a walk.
  *
  * @param uri             <b>IN</b>: %URI to measure
  * @param charsRequired   <b>OUT</b>: Length of the string representation in characters <b>excluding</b> terminator
@@ -644,6 +1161,118 @@ URI_PUBLIC int URI_FUNC(ToString)(URI_CHAR * dest, const URI_TYPE(Uri) * uri,
 
 
 
+/**
+ * Calculates the number of characters needed to store the
+ * syntax-normalized string representation of the given %URI
+ * excluding the terminator.
+ *
+ * @param uri             <b>IN</b>: %URI to measure
+ * @param mask            <b>IN</b>: Normalization mask
+ * @param charsRequired   <b>OUT</b>: Length of the string representation in characters <b>excluding</b> terminator
+ * @return                Error code or 0 on success
+ *
+ * @see uriToNormalizedStringA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ToNormalizedStringCharsRequired)(
+		const URI_TYPE(Uri) * uri, unsigned int mask, int * charsRequired);
+
+
+
+/**
+ * Converts a %URI structure to text the way it would read after
+ * normalizing it with ::uriNormalizeSyntaxExA and the same mask.
+ * Case normalization, percent-encoding normalization and removal
+ * of dot segments are applied while writing; the %URI itself
+ * is neither modified nor copied and no memory is allocated.
+ *
+ * @param dest           <b>OUT</b>: Output destination
+ * @param uri            <b>IN</b>: %URI to convert
+ * @param mask           <b>IN</b>: Normalization mask
+ * @param maxChars       <b>IN</b>: Maximum number of characters to copy <b>including</b> terminator
+ * @param charsWritten   <b>OUT</b>: Number of characters written, can be lower than maxChars even if the %URI is too long!
+ * @return               Error code or 0 on success
+ *
+ * @see uriToNormalizedStringCharsRequiredA
+ * @see uriNormalizeSyntaxExA
+ * @see uriToStringA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ToNormalizedString)(URI_CHAR * dest,
+		const URI_TYPE(Uri) * uri, unsigned int mask, int maxChars,
+		int * charsWritten);
+
+
+
+/**
+ * Converts a %URI structure back to text, see uriToStringA,
+ * into a string of exactly the size needed.
+ * Memory for this string is allocated internally.
+ * Uses default libc-based memory manager.
+ *
+ * @param dest           <b>OUT</b>: Output destination
+ * @param uri            <b>IN</b>: %URI to convert
+ * @param charsWritten   <b>OUT</b>: Number of characters written <b>including</b> terminator, can be NULL
+ * @return               Error code or 0 on success
+ *
+ * @see uriToStringMallocExMmA
+ * @see uriToStringA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ToStringMalloc)(URI_CHAR ** dest,
+		const URI_TYPE(Uri) * uri, int * charsWritten);
+
+
+
+/**
+ * Converts a %URI structure to text the way it would read after
+ * normalizing it with ::uriNormalizeSyntaxExA and the given mask,
+ * see uriToNormalizedStringA, into a string of exactly the size needed.
+ * Memory for this string is allocated internally.
+ * Uses default libc-based memory manager.
+ *
+ * @param dest           <b>OUT</b>: Output destination
+ * @param uri            <b>IN</b>: %URI to convert
+ * @param mask           <b>IN</b>: Normalization mask, <c>URI_NORMALIZED</c> for text as is
+ * @param charsWritten   <b>OUT</b>: Number of characters written <b>including</b> terminator, can be NULL
+ * @return               Error code or 0 on success
+ *
+ * @see uriToStringMallocA
+ * @see uriToStringMallocExMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ToStringMallocEx)(URI_CHAR ** dest,
+		const URI_TYPE(Uri) * uri, unsigned int mask, int * charsWritten);
+
+
+
+/**
+ * Converts a %URI structure to text the way it would read after
+ * normalizing it with ::uriNormalizeSyntaxExA and the given mask,
+ * see uriToNormalizedStringA, into a string of exactly the size needed.
+ * Text of typical length is written to a buffer on the stack first,
+ * so the %URI is walked only once; longer text takes a second walk.
+ * For a frozen %URI (see uriFreezeUriMmA) the length is known in advance.
+ * The string is released by <c>memory->free(memory, *dest)</c>.
+ *
+ * @param dest           <b>OUT</b>: Output destination
+ * @param uri            <b>IN</b>: %URI to convert
+ * @param mask           <b>IN</b>: Normalization mask, <c>URI_NORMALIZED</c> for text as is
+ * @param charsWritten   <b>OUT</b>: Number of characters written <b>including</b> terminator, can be NULL
+ * @param memory         <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return               Error code or 0 on success
+ *
+ * @see uriToStringMallocA
+ * @see uriToStringMallocExA
+ * @see uriToNormalizedStringA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ToStringMallocExMm)(URI_CHAR ** dest,
+		const URI_TYPE(Uri) * uri, unsigned int mask, int * charsWritten,
+		UriMemoryManager * memory);
+
+
+
 /**
  * Determines the components of a %URI that are not normalized.
  *
@@ -681,12 +1310,37 @@ URI_PUBLIC int URI_FUNC(NormalizeSyntaxMaskRequiredEx)(
 
 
 /**
- * Normalizes a %URI using a normalization mask.
- * The normalization mask decides what components are normalized.
- *
- * NOTE: If necessary the %URI becomes owner of all memory
- * behind the text pointed to. Text is duplicated in that case.
- * Uses default libc-based memory manager.
+ * Determines the normalization steps of interest that would change
+ * a %URI, including scheme-based ones like ::URI_NORMALIZE_PORT which
+ * uriNormalizeSyntaxMaskRequiredExA never reports.  Only flags in
+ * <c>inMask</c> are reported; masks with bits beyond the known flags,
+ * like <c>(unsigned int)-1</c>, stand for syntax-based normalization
+ * only, as with uriNormalizeSyntaxExA.  The resulting mask can be passed to
+ * uriNormalizeSyntaxExA as is.
+ *
+ * @param uri      <b>IN</b>: %URI to check
+ * @param inMask   <b>IN</b>: Normalization steps of interest
+ * @param outMask  <b>OUT</b>: Normalization job mask
+ * @return         Error code or 0 on success
+ *
+ * @see uriNormalizeSyntaxMaskRequiredExA
+ * @see uriNormalizeSyntaxExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(NormalizeMaskRequired)(const URI_TYPE(Uri) * uri,
+		unsigned int inMask, unsigned int * outMask);
+
+
+
+/**
+ * Normalizes a %URI using a normalization mask.
+ * The normalization mask decides what components are normalized.
+ *
+ * NOTE: If necessary the %URI becomes owner of all memory
+ * behind the text pointed to. Text is duplicated in that case,
+ * into a single block, so text of a single component must not
+ * be freed or replaced afterwards, see UriUriA.
+ * Uses default libc-based memory manager.
  *
  * @param uri    <b>INOUT</b>: %URI to normalize
  * @param mask   <b>IN</b>: Normalization mask
@@ -707,7 +1361,10 @@ URI_PUBLIC int URI_FUNC(NormalizeSyntaxEx)(URI_TYPE(Uri) * uri,
  * The normalization mask decides what components are normalized.
  *
  * NOTE: If necessary the %URI becomes owner of all memory
- * behind the text pointed to. Text is duplicated in that case.
+ * behind the text pointed to. Text is duplicated in that case,
+ * into a single allocation, and the %URI is left untouched
+ * if that allocation fails.  Text of a single component
+ * must not be freed or replaced afterwards, see UriUriA.
  *
  * @param uri    <b>INOUT</b>: %URI to normalize
  * @param mask   <b>IN</b>: Normalization mask
@@ -728,7 +1385,9 @@ URI_PUBLIC int URI_FUNC(NormalizeSyntaxExMm)(URI_TYPE(Uri) * uri,
  * Normalizes all components of a %URI.
  *
  * NOTE: If necessary the %URI becomes owner of all memory
- * behind the text pointed to. Text is duplicated in that case.
+ * behind the text pointed to. Text is duplicated in that case,
+ * into a single block, so text of a single component must not
+ * be freed or replaced afterwards, see UriUriA.
  * Uses default libc-based memory manager.
  *
  * @param uri   <b>INOUT</b>: %URI to normalize
@@ -1000,6 +1659,98 @@ URI_PUBLIC int URI_FUNC(ComposeQueryMallocExMm)(URI_CHAR ** dest,
 
 
 
+/**
+ * Calculates the number of characters needed to store the
+ * string representation of the given query range list.
+ * Escaping of a key or value stops early at a NUL character
+ * just like with uriEscapeExA.
+ *
+ * @param queryList         <b>IN</b>: Query range list to measure
+ * @param charsRequired     <b>OUT</b>: Length of the string representation in characters <b>excluding</b> terminator
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @return                  Error code or 0 on success
+ *
+ * @see uriComposeQueryRangeListExA
+ * @see uriComposeQueryCharsRequiredExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ComposeQueryRangeListCharsRequiredEx)(
+		const URI_TYPE(QueryRangeList) * queryList,
+		int * charsRequired, UriBool spaceToPlus, UriBool normalizeBreaks);
+
+
+
+/**
+ * Converts a query range list structure back to a query string.
+ * The composed string does not start with '?',
+ * on the way ' ' is converted to '+' and line breaks are
+ * normalized to "%0D%0A" if requested.
+ *
+ * @param dest              <b>OUT</b>: Output destination
+ * @param queryList         <b>IN</b>: Query range list to convert
+ * @param maxChars          <b>IN</b>: Maximum number of characters to copy <b>including</b> terminator
+ * @param charsWritten      <b>OUT</b>: Number of characters written, can be lower than maxChars even if the query list is too long!
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @return                  Error code or 0 on success
+ *
+ * @see uriComposeQueryRangeListCharsRequiredExA
+ * @see uriComposeQueryRangeListMallocExMmA
+ * @see uriComposeQueryExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ComposeQueryRangeListEx)(URI_CHAR * dest,
+		const URI_TYPE(QueryRangeList) * queryList, int maxChars,
+		int * charsWritten, UriBool spaceToPlus, UriBool normalizeBreaks);
+
+
+
+/**
+ * Converts a query range list structure back to a query string.
+ * Memory for this string is allocated internally.
+ * The composed string does not start with '?'.
+ * Uses default libc-based memory manager.
+ *
+ * @param dest              <b>OUT</b>: Output destination
+ * @param queryList         <b>IN</b>: Query range list to convert
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @return                  Error code or 0 on success
+ *
+ * @see uriComposeQueryRangeListMallocExMmA
+ * @see uriComposeQueryRangeListExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ComposeQueryRangeListMallocEx)(URI_CHAR ** dest,
+		const URI_TYPE(QueryRangeList) * queryList,
+		UriBool spaceToPlus, UriBool normalizeBreaks);
+
+
+
+/**
+ * Converts a query range list structure back to a query string.
+ * Memory for this string is allocated internally.
+ * The composed string does not start with '?'.
+ *
+ * @param dest              <b>OUT</b>: Output destination
+ * @param queryList         <b>IN</b>: Query range list to convert
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @param memory            <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return                  Error code or 0 on success
+ *
+ * @see uriComposeQueryRangeListMallocExA
+ * @see uriComposeQueryRangeListExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(ComposeQueryRangeListMallocExMm)(URI_CHAR ** dest,
+		const URI_TYPE(QueryRangeList) * queryList,
+		UriBool spaceToPlus, UriBool normalizeBreaks,
+		UriMemoryManager * memory);
+
+
+
 /**
  * Constructs a query list from the raw query string of a given URI.
  * On the way '+' is converted back to ' ', line breaks are not modified.
@@ -1073,6 +1824,501 @@ URI_PUBLIC int URI_FUNC(DissectQueryMallocExMm)(URI_TYPE(QueryList) ** dest,
 
 
 
+/**
+ * Constructs a query list from the raw query string of a given URI
+ * using a single allocation.  The items are laid out as an array, i.e.
+ * <c>(*dest)[i]</c> for <c>0 <= i < *itemCount</c>, and are linked
+ * through <c>next</c> as well so they can be passed to
+ * uriComposeQueryA and friends.  Keys and values live in the same block.
+ * The whole list is released by a single call to <c>free(*dest)</c>;
+ * do not pass it to uriFreeQueryListA.
+ * Uses default libc-based memory manager.
+ *
+ * @param dest              <b>OUT</b>: Output destination, NULL if no items
+ * @param itemCount         <b>OUT</b>: Number of items found, can be NULL
+ * @param first             <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast         <b>IN</b>: Pointer to character after the last one still in
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @return                  Error code or 0 on success
+ *
+ * @see uriDissectQueryArrayMallocExMmA
+ * @see uriDissectQueryMallocExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(DissectQueryArrayMallocEx)(URI_TYPE(QueryList) ** dest,
+		int * itemCount, const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion);
+
+
+
+/**
+ * Constructs a query list from the raw query string of a given URI
+ * using a single allocation, see uriDissectQueryArrayMallocExA.
+ * The whole list is released by a single call to
+ * <c>memory->free(memory, *dest)</c>.
+ *
+ * @param dest              <b>OUT</b>: Output destination, NULL if no items
+ * @param itemCount         <b>OUT</b>: Number of items found, can be NULL
+ * @param first             <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast         <b>IN</b>: Pointer to character after the last one still in
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @param memory            <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return                  Error code or 0 on success
+ *
+ * @see uriDissectQueryArrayMallocExA
+ * @see uriDissectQueryMallocExMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(DissectQueryArrayMallocExMm)(URI_TYPE(QueryList) ** dest,
+		int * itemCount, const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriMemoryManager * memory);
+
+
+
+/**
+ * Constructs a query range list from the raw query string of a given URI
+ * using a single allocation.  Items are laid out as an array linked
+ * through <c>next</c>.  Keys and values that unescaping would not change
+ * point right into <c>[first, afterLast)</c>, so that buffer must outlive
+ * the list; all others are unescaped into the same block.
+ * The whole list is released by a single call to <c>free(*dest)</c>.
+ * Uses default libc-based memory manager.
+ *
+ * @param dest              <b>OUT</b>: Output destination, NULL if no items
+ * @param itemCount         <b>OUT</b>: Number of items found, can be NULL
+ * @param first             <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast         <b>IN</b>: Pointer to character after the last one still in
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @return                  Error code or 0 on success
+ *
+ * @see uriDissectQueryRangeListMallocExMmA
+ * @see uriComposeQueryRangeListExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(DissectQueryRangeListMallocEx)(
+		URI_TYPE(QueryRangeList) ** dest,
+		int * itemCount, const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion);
+
+
+
+/**
+ * Constructs a query range list from the raw query string of a given URI
+ * using a single allocation, see uriDissectQueryRangeListMallocExA.
+ * The whole list is released by a single call to
+ * <c>memory->free(memory, *dest)</c>.
+ *
+ * @param dest              <b>OUT</b>: Output destination, NULL if no items
+ * @param itemCount         <b>OUT</b>: Number of items found, can be NULL
+ * @param first             <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast         <b>IN</b>: Pointer to character after the last one still in
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @param memory            <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return                  Error code or 0 on success
+ *
+ * @see uriDissectQueryRangeListMallocExA
+ * @see uriComposeQueryRangeListExA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(DissectQueryRangeListMallocExMm)(
+		URI_TYPE(QueryRangeList) ** dest,
+		int * itemCount, const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriMemoryManager * memory);
+
+
+
+/**
+ * Dissects the raw query string of a given URI and indexes the items by
+ * unescaped key for lookups in constant time, including keys that occur
+ * more than once.  Items, index, keys and values live in a single block
+ * that is released by a single call to <c>free(*dest)</c>.
+ * Uses default libc-based memory manager.
+ *
+ * @param dest              <b>OUT</b>: Output destination
+ * @param first             <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast         <b>IN</b>: Pointer to character after the last one still in
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @return                  Error code or 0 on success
+ *
+ * @see uriQueryMapMallocExMmA
+ * @see uriQueryMapFindA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryMapMallocEx)(URI_TYPE(QueryMap) ** dest,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion);
+
+
+
+/**
+ * Dissects the raw query string of a given URI and indexes the items by
+ * unescaped key, see uriQueryMapMallocExA.  The map is released by
+ * a single call to <c>memory->free(memory, *dest)</c>.
+ *
+ * @param dest              <b>OUT</b>: Output destination
+ * @param first             <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast         <b>IN</b>: Pointer to character after the last one still in
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @param memory            <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return                  Error code or 0 on success
+ *
+ * @see uriQueryMapMallocExA
+ * @see uriQueryMapFindA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryMapMallocExMm)(URI_TYPE(QueryMap) ** dest,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriMemoryManager * memory);
+
+
+
+/**
+ * Looks up the first item (in query order) with the given unescaped key.
+ * Keys are compared in full, so a key unescaped from "a%00b"
+ * does not match "a".
+ *
+ * @param map   <b>IN</b>: Map made by uriQueryMapMallocExMmA
+ * @param key   <b>IN</b>: Unescaped zero-terminated key to look for
+ * @return      Item found or NULL
+ *
+ * @see uriQueryMapFindNextA
+ * @since 0.9.9
+ */
+URI_PUBLIC const URI_TYPE(QueryList) * URI_FUNC(QueryMapFind)(
+		const URI_TYPE(QueryMap) * map, const URI_CHAR * key);
+
+
+
+/**
+ * Looks up the next item (in query order) with the same key
+ * as the item given.
+ *
+ * @param map    <b>IN</b>: Map made by uriQueryMapMallocExMmA
+ * @param item   <b>IN</b>: Item previously returned by uriQueryMapFindA or this function
+ * @return       Item found or NULL
+ *
+ * @see uriQueryMapFindA
+ * @since 0.9.9
+ */
+URI_PUBLIC const URI_TYPE(QueryList) * URI_FUNC(QueryMapFindNext)(
+		const URI_TYPE(QueryMap) * map, const URI_TYPE(QueryList) * item);
+
+
+
+/**
+ * Prepares a query decoder, see uriQueryDecoderInitMmA.
+ * Uses default libc-based memory manager.
+ *
+ * @param decoder           <b>OUT</b>: Decoder to initialize
+ * @param callback          <b>IN</b>: Function to call per item
+ * @param userData          <b>IN</b>: Passed to callback as is
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @return                  Error code or 0 on success
+ *
+ * @see uriQueryDecoderInitMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryDecoderInit)(URI_TYPE(QueryDecoder) * decoder,
+		URI_TYPE(QueryItemCallback) callback, void * userData,
+		UriBool plusToSpace, UriBreakConversion breakConversion);
+
+
+
+/**
+ * Prepares a query decoder that accepts a query string (or an
+ * application/x-www-form-urlencoded body) in chunks of any size
+ * and passes each item to a callback as soon as it is complete.
+ * Items are split and unescaped exactly like uriDissectQueryMallocExMmA
+ * does, including '=', '&' and percent-encodings split across chunks.
+ * Only the item in progress is buffered, so memory use is bounded
+ * by the largest single item rather than the whole input.
+ *
+ * @param decoder           <b>OUT</b>: Decoder to initialize
+ * @param callback          <b>IN</b>: Function to call per item
+ * @param userData          <b>IN</b>: Passed to callback as is
+ * @param plusToSpace       <b>IN</b>: Whether to convert '+' to ' ' or not
+ * @param breakConversion   <b>IN</b>: Line break conversion mode
+ * @param memory            <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return                  Error code or 0 on success
+ *
+ * @see uriQueryDecoderFeedA
+ * @see uriQueryDecoderFinishA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryDecoderInitMm)(URI_TYPE(QueryDecoder) * decoder,
+		URI_TYPE(QueryItemCallback) callback, void * userData,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriMemoryManager * memory);
+
+
+
+/**
+ * Passes the next chunk of input to a query decoder.
+ * The callback is invoked for every item completed by this chunk.
+ * Once an error has occurred or the callback has returned non-zero,
+ * the decoder keeps returning that value.
+ *
+ * @param decoder     <b>INOUT</b>: Decoder set up by uriQueryDecoderInitMmA
+ * @param first       <b>IN</b>: Pointer to first character of the chunk
+ * @param afterLast   <b>IN</b>: Pointer to character after the last one still in
+ * @return            Error code or 0 on success
+ *
+ * @see uriQueryDecoderFinishA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryDecoderFeed)(URI_TYPE(QueryDecoder) * decoder,
+		const URI_CHAR * first, const URI_CHAR * afterLast);
+
+
+
+/**
+ * Signals the end of input to a query decoder, passes the last item
+ * (if any) to the callback and releases all memory held by the decoder.
+ * Has to be called even after errors.
+ *
+ * @param decoder   <b>INOUT</b>: Decoder set up by uriQueryDecoderInitMmA
+ * @return          Error code, non-zero callback result or 0 on success
+ *
+ * @see uriQueryDecoderFeedA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryDecoderFinish)(URI_TYPE(QueryDecoder) * decoder);
+
+
+
+/**
+ * Prepares a query builder writing to a fixed buffer owned by the caller.
+ * The buffer is zero-terminated right away and after each item.
+ * Items that do not fit are rejected with URI_ERROR_OUTPUT_TOO_LARGE,
+ * leaving what has been composed so far untouched.
+ *
+ * @param builder           <b>OUT</b>: Builder to initialize
+ * @param dest              <b>OUT</b>: Output destination
+ * @param maxChars          <b>IN</b>: Size of dest in characters <b>including</b> terminator
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @return                  Error code or 0 on success
+ *
+ * @see uriQueryBuilderInitMmA
+ * @see uriQueryBuilderAppendA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryBuilderInit)(URI_TYPE(QueryBuilder) * builder,
+		URI_CHAR * dest, int maxChars,
+		UriBool spaceToPlus, UriBool normalizeBreaks);
+
+
+
+/**
+ * Prepares a query builder writing to a buffer that is allocated
+ * on the first item and grown as needed.  Nothing is allocated here.
+ * Release the buffer with uriQueryBuilderFreeA or take it over
+ * with uriQueryBuilderDetachA.
+ *
+ * @param builder           <b>OUT</b>: Builder to initialize
+ * @param spaceToPlus       <b>IN</b>: Whether to convert ' ' to '+' or not
+ * @param normalizeBreaks   <b>IN</b>: Whether to convert CR and LF to CR-LF or not.
+ * @param memory            <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return                  Error code or 0 on success
+ *
+ * @see uriQueryBuilderInitA
+ * @see uriQueryBuilderAppendA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryBuilderInitMm)(URI_TYPE(QueryBuilder) * builder,
+		UriBool spaceToPlus, UriBool normalizeBreaks,
+		UriMemoryManager * memory);
+
+
+
+/**
+ * Escapes a key and an optional value and appends them to the
+ * query composed so far, preceded by '&' unless it is the first item.
+ * The result is the same as composing a matching
+ * query list with uriComposeQueryExA.
+ *
+ * @param builder          <b>INOUT</b>: Builder to append to
+ * @param keyFirst         <b>IN</b>: Pointer to first character of the key
+ * @param keyAfterLast     <b>IN</b>: Pointer to character after the last one of the key, NULL if the key is zero-terminated
+ * @param valueFirst       <b>IN</b>: Pointer to first character of the value, NULL for no value (and no '=')
+ * @param valueAfterLast   <b>IN</b>: Pointer to character after the last one of the value, NULL if the value is zero-terminated
+ * @return                 Error code or 0 on success
+ *
+ * @see uriQueryBuilderInitA
+ * @see uriQueryBuilderInitMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryBuilderAppend)(URI_TYPE(QueryBuilder) * builder,
+		const URI_CHAR * keyFirst, const URI_CHAR * keyAfterLast,
+		const URI_CHAR * valueFirst, const URI_CHAR * valueAfterLast);
+
+
+
+/**
+ * Hands the composed query over to the caller and resets the builder.
+ * With a managed buffer, the caller becomes responsible for releasing
+ * <c>*dest</c> through <c>memory->free</c> (or <c>free</c> for the
+ * default memory manager); a builder without items yields "".
+ * With a caller-owned buffer, that buffer is returned.
+ *
+ * @param builder   <b>INOUT</b>: Builder to take the query from
+ * @param dest      <b>OUT</b>: Output destination
+ * @return          Error code or 0 on success
+ *
+ * @see uriQueryBuilderFreeA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryBuilderDetach)(URI_TYPE(QueryBuilder) * builder,
+		URI_CHAR ** dest);
+
+
+
+/**
+ * Releases the buffer of a query builder unless it is owned by the
+ * caller and resets the builder to hold no items.
+ *
+ * @param builder   <b>INOUT</b>: Builder to release
+ * @return          Error code or 0 on success
+ *
+ * @see uriQueryBuilderDetachA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryBuilderFree)(URI_TYPE(QueryBuilder) * builder);
+
+
+
+/**
+ * Removes all items from a raw query string whose unescaped key
+ * matches one of the given patterns, in a single pass.
+ * A pattern matches a key that is equal to it, a pattern ending
+ * in '*' (e.g. "utm_*") matches all keys starting with the part before.
+ * The remaining items are copied to dest as is, joined by '&'.
+ * Empty items (e.g. from "&&") are dropped as well.
+ * The result is <b>not</b> zero-terminated.
+ *
+ * @param dest            <b>OUT</b>: Output destination, room for <c>afterLast - first</c> characters, can be <c>first</c> to filter in place
+ * @param destAfterLast   <b>OUT</b>: Pointer to character after the last one written
+ * @param first           <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast       <b>IN</b>: Pointer to character after the last one still in
+ * @param patterns        <b>IN</b>: Zero-terminated patterns to match keys against
+ * @param patternCount    <b>IN</b>: Number of patterns
+ * @param plusToSpace     <b>IN</b>: Whether to convert '+' in keys to ' ' before matching or not
+ * @return                Error code or 0 on success
+ *
+ * @see uriFilterUriQueryA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(FilterQuery)(URI_CHAR * dest,
+		URI_CHAR ** destAfterLast,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		const URI_CHAR * const * patterns, int patternCount,
+		UriBool plusToSpace);
+
+
+
+/**
+ * Removes all items from the query of a %URI whose unescaped key
+ * matches one of the given patterns, see uriFilterQueryA.
+ * The query is compacted in place; a %URI not owning its
+ * text yet is made owner first.  If no items remain,
+ * the query is removed altogether (including the '?').
+ * Uses default libc-based memory manager.
+ *
+ * @param uri            <b>INOUT</b>: %URI to filter the query of
+ * @param patterns       <b>IN</b>: Zero-terminated patterns to match keys against
+ * @param patternCount   <b>IN</b>: Number of patterns
+ * @param plusToSpace    <b>IN</b>: Whether to convert '+' in keys to ' ' before matching or not
+ * @return               Error code or 0 on success
+ *
+ * @see uriFilterUriQueryMmA
+ * @see uriFilterQueryA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(FilterUriQuery)(URI_TYPE(Uri) * uri,
+		const URI_CHAR * const * patterns, int patternCount,
+		UriBool plusToSpace);
+
+
+
+/**
+ * Removes all items from the query of a %URI whose unescaped key
+ * matches one of the given patterns, see uriFilterUriQueryA.
+ *
+ * @param uri            <b>INOUT</b>: %URI to filter the query of
+ * @param patterns       <b>IN</b>: Zero-terminated patterns to match keys against
+ * @param patternCount   <b>IN</b>: Number of patterns
+ * @param plusToSpace    <b>IN</b>: Whether to convert '+' in keys to ' ' before matching or not
+ * @param memory         <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return               Error code or 0 on success
+ *
+ * @see uriFilterUriQueryA
+ * @see uriFilterQueryA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(FilterUriQueryMm)(URI_TYPE(Uri) * uri,
+		const URI_CHAR * const * patterns, int patternCount,
+		UriBool plusToSpace, UriMemoryManager * memory);
+
+
+
+/**
+ * Rewrites a raw query string into a canonical form suitable for
+ * comparison, e.g. as part of a cache key: items are sorted by key
+ * (keeping the original order of items with equal keys),
+ * percent-encodings are normalized like uriNormalizeSyntaxA does
+ * and empty or duplicate items are dropped if requested.
+ * Keys are compared after percent-encoding normalization,
+ * code unit by code unit; '+' is left alone.
+ * Uses default libc-based memory manager.
+ *
+ * @param dest           <b>OUT</b>: Output destination, release with <c>free</c>
+ * @param charsWritten   <b>OUT</b>: Number of characters written <b>including</b> terminator, can be NULL
+ * @param first          <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast      <b>IN</b>: Pointer to character after the last one still in
+ * @param options        <b>IN</b>: Items to drop, see UriQueryCanonicalizationOptions
+ * @return               Error code or 0 on success
+ *
+ * @see uriCanonicalizeQueryMallocMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(CanonicalizeQueryMalloc)(URI_CHAR ** dest,
+		int * charsWritten, const URI_CHAR * first, const URI_CHAR * afterLast,
+		unsigned int options);
+
+
+
+/**
+ * Rewrites a raw query string into a canonical form suitable for
+ * comparison, see uriCanonicalizeQueryMallocA.
+ * All work is done within a single allocation.
+ *
+ * @param dest           <b>OUT</b>: Output destination, release with <c>memory->free</c>
+ * @param charsWritten   <b>OUT</b>: Number of characters written <b>including</b> terminator, can be NULL
+ * @param first          <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast      <b>IN</b>: Pointer to character after the last one still in
+ * @param options        <b>IN</b>: Items to drop, see UriQueryCanonicalizationOptions
+ * @param memory         <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return               Error code or 0 on success
+ *
+ * @see uriCanonicalizeQueryMallocA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(CanonicalizeQueryMallocMm)(URI_CHAR ** dest,
+		int * charsWritten, const URI_CHAR * first, const URI_CHAR * afterLast,
+		unsigned int options, UriMemoryManager * memory);
+
+
+
 /**
  * Frees all memory associated with the given query list.
  * The structure itself is freed as well.
@@ -1102,10 +2348,146 @@ URI_PUBLIC int URI_FUNC(FreeQueryListMm)(URI_TYPE(QueryList) * queryList,
 
 
 
+/**
+ * Prepares a query iterator for walking the raw query string of a given URI.
+ *
+ * @param iterator    <b>OUT</b>: Iterator to initialize
+ * @param first       <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast   <b>IN</b>: Pointer to character after the last one still in
+ * @return            Error code or 0 on success
+ *
+ * @see uriQueryIteratorNextA
+ * @see uriDissectQueryMallocExMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryIteratorInit)(URI_TYPE(QueryIterator) * iterator,
+		const URI_CHAR * first, const URI_CHAR * afterLast);
+
+
+
+/**
+ * Advances a query iterator to the next item and reports its raw,
+ * still percent-encoded key and value ranges pointing into the query string.
+ * Items are split exactly like uriDissectQueryMallocExMmA does:
+ * the first '=' separates key and value, and items with neither key
+ * nor '=' (e.g. from "&&") are skipped.  For items without '=',
+ * both members of <c>value</c> are set to NULL.
+ *
+ * The ranges can be unescaped on demand, e.g. by copying them
+ * to a buffer of your own and applying uriUnescapeInPlaceExA.
+ *
+ * @param iterator        <b>INOUT</b>: Iterator set up by uriQueryIteratorInitA
+ * @param key             <b>OUT</b>: Raw key of the item
+ * @param value           <b>OUT</b>: Raw value of the item, both members NULL if none
+ * @param needsUnescape   <b>OUT</b>: Whether key or value contain '%' or '+', can be NULL
+ * @return                <c>URI_TRUE</c> if an item was found, <c>URI_FALSE</c> when done
+ *
+ * @see uriQueryIteratorInitA
+ * @since 0.9.9
+ */
+URI_PUBLIC UriBool URI_FUNC(QueryIteratorNext)(
+		URI_TYPE(QueryIterator) * iterator,
+		URI_TYPE(TextRange) * key, URI_TYPE(TextRange) * value,
+		UriBool * needsUnescape);
+
+
+
+/**
+ * Looks up the first item of a raw query string with the given key
+ * without dissecting the query.  Raw keys are compared as if unescaped
+ * (with line breaks left untouched), so that e.g. key "a b" matches
+ * both "a%20b=" and, with <c>plusToSpace</c>, "a+b=".
+ * To find all items with that key, use uriQueryIteratorFindA.
+ *
+ * @param first          <b>IN</b>: Pointer to first character <b>after</b> '?'
+ * @param afterLast      <b>IN</b>: Pointer to character after the last one still in
+ * @param key            <b>IN</b>: Unescaped key to look for
+ * @param keyAfterLast   <b>IN</b>: Pointer to character after the last one still in, NULL to use <c>strlen(key)</c>
+ * @param plusToSpace    <b>IN</b>: Whether to treat '+' in raw keys as ' ' or not
+ * @param value          <b>OUT</b>: Raw value of the item found, both members NULL if it has no '='
+ * @return               <c>URI_TRUE</c> if found, <c>URI_FALSE</c> if not or on invalid parameters
+ *
+ * @see uriQueryIteratorFindA
+ * @see uriQueryIteratorFindKeySetA
+ * @since 0.9.9
+ */
+URI_PUBLIC UriBool URI_FUNC(QueryFind)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, const URI_CHAR * key,
+		const URI_CHAR * keyAfterLast, UriBool plusToSpace,
+		URI_TYPE(TextRange) * value);
+
+
+
+/**
+ * Advances a query iterator to the next item with the given key.
+ * Keys are compared like uriQueryFindA does.  Calling this repeatedly
+ * yields all items with that key, in order.
+ *
+ * @param iterator       <b>INOUT</b>: Iterator set up by uriQueryIteratorInitA
+ * @param key            <b>IN</b>: Unescaped key to look for
+ * @param keyAfterLast   <b>IN</b>: Pointer to character after the last one still in, NULL to use <c>strlen(key)</c>
+ * @param plusToSpace    <b>IN</b>: Whether to treat '+' in raw keys as ' ' or not
+ * @param value          <b>OUT</b>: Raw value of the item found, both members NULL if it has no '='
+ * @return               <c>URI_TRUE</c> if found, <c>URI_FALSE</c> when done
+ *
+ * @see uriQueryFindA
+ * @see uriQueryIteratorInitA
+ * @since 0.9.9
+ */
+URI_PUBLIC UriBool URI_FUNC(QueryIteratorFind)(
+		URI_TYPE(QueryIterator) * iterator, const URI_CHAR * key,
+		const URI_CHAR * keyAfterLast, UriBool plusToSpace,
+		URI_TYPE(TextRange) * value);
+
+
+
+/**
+ * Precompiles a set of keys for uriQueryIteratorFindKeySetA.
+ * The key array and strings are not copied and must outlive the set.
+ *
+ * @param keySet     <b>OUT</b>: Key set to initialize
+ * @param keys       <b>IN</b>: Unescaped zero-terminated keys to look for
+ * @param keyCount   <b>IN</b>: Number of keys, at most #URI_QUERY_KEY_SET_MAX_KEYS
+ * @return           Error code or 0 on success
+ *
+ * @see uriQueryIteratorFindKeySetA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(QueryKeySetInit)(URI_TYPE(QueryKeySet) * keySet,
+		const URI_CHAR * const * keys, int keyCount);
+
+
+
+/**
+ * Advances a query iterator to the next item whose key is
+ * in the given key set, looking at each item's key only once
+ * no matter how many keys there are.
+ * Keys are compared like uriQueryFindA does.
+ *
+ * @param iterator      <b>INOUT</b>: Iterator set up by uriQueryIteratorInitA
+ * @param keySet        <b>IN</b>: Key set set up by uriQueryKeySetInitA
+ * @param plusToSpace   <b>IN</b>: Whether to treat '+' in raw keys as ' ' or not
+ * @param keyIndex      <b>OUT</b>: Index of the matching key in the key set, can be NULL
+ * @param value         <b>OUT</b>: Raw value of the item found, both members NULL if it has no '='
+ * @return              <c>URI_TRUE</c> if found, <c>URI_FALSE</c> when done
+ *
+ * @see uriQueryKeySetInitA
+ * @see uriQueryIteratorFindA
+ * @since 0.9.9
+ */
+URI_PUBLIC UriBool URI_FUNC(QueryIteratorFindKeySet)(
+		URI_TYPE(QueryIterator) * iterator,
+		const URI_TYPE(QueryKeySet) * keySet, UriBool plusToSpace,
+		int * keyIndex, URI_TYPE(TextRange) * value);
+
+
+
 /**
  * Makes the %URI hold copies of strings so that it no longer depends
  * on the original %URI string.  If the %URI is already owner of copies,
  * this function returns <c>URI_TRUE</c> and does not modify the %URI further.
+ * All text ends up in a single block, so text of a single component
+ * must not be freed or replaced afterwards, see UriUriA.
  *
  * Uses default libc-based memory manager.
  *
@@ -1123,6 +2505,10 @@ URI_PUBLIC int URI_FUNC(MakeOwner)(URI_TYPE(Uri) * uri);
  * Makes the %URI hold copies of strings so that it no longer depends
  * on the original %URI string.  If the %URI is already owner of copies,
  * this function returns <c>URI_TRUE</c> and does not modify the %URI further.
+ * Since 0.9.9, all text, path segment nodes and binary host data end up in
+ * a single allocation, see uriCopyUriMmA, and the %URI is left untouched
+ * on failure.  Text of a single component must not be freed or replaced
+ * afterwards, see UriUriA.
  *
  * @param uri     <b>INOUT</b>: %URI to make independent
  * @param memory  <b>IN</b>: Memory manager to use, NULL for default libc
@@ -1136,6 +2522,147 @@ URI_PUBLIC int URI_FUNC(MakeOwnerMm)(URI_TYPE(Uri) * uri,
 
 
 
+/**
+ * Copies a %URI into <c>dest</c> so that the copy is independent of
+ * both <c>source</c> and the string <c>source</c> was parsed from.
+ * All text, path segment nodes and binary host data of the copy share
+ * a single allocation.  The copy is owner of its memory and must be
+ * freed using uriFreeUriMembersA; it may be normalized like any other %URI.
+ * Previous content of <c>dest</c> is overwritten without being freed.
+ *
+ * Uses default libc-based memory manager.
+ *
+ * @param dest    <b>OUT</b>: Output destination
+ * @param source  <b>IN</b>: %URI to copy
+ * @return        Error code or 0 on success
+ *
+ * @see uriCopyUriMmA
+ * @see uriMakeOwnerA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(CopyUri)(URI_TYPE(Uri) * dest,
+		const URI_TYPE(Uri) * source);
+
+
+
+/**
+ * Copies a %URI into <c>dest</c> so that the copy is independent of
+ * both <c>source</c> and the string <c>source</c> was parsed from.
+ * All text, path segment nodes and binary host data of the copy share
+ * a single allocation.  The copy is owner of its memory and must be
+ * freed using uriFreeUriMembersMmA with the same memory manager.
+ * Previous content of <c>dest</c> is overwritten without being freed;
+ * on failure, <c>dest</c> is left untouched.
+ *
+ * @param dest    <b>OUT</b>: Output destination
+ * @param source  <b>IN</b>: %URI to copy
+ * @param memory  <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return        Error code or 0 on success
+ *
+ * @see uriCopyUriA
+ * @see uriMakeOwnerMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(CopyUriMm)(URI_TYPE(Uri) * dest,
+		const URI_TYPE(Uri) * source, UriMemoryManager * memory);
+
+
+
+/**
+ * Copies a %URI into a new immutable, reference-counted object so that
+ * it can be shared between threads without further copies, see
+ * uriFreezeUriMmA.
+ * Uses default libc-based memory manager.
+ *
+ * @param dest    <b>OUT</b>: Output destination, holds one reference
+ * @param source  <b>IN</b>: %URI to freeze
+ * @return        Error code or 0 on success
+ *
+ * @see uriFreezeUriMmA
+ * @see uriFrozenUriReleaseA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(FreezeUri)(const URI_TYPE(FrozenUri) ** dest,
+		const URI_TYPE(Uri) * source);
+
+
+
+/**
+ * Copies a %URI into a new immutable, reference-counted object so that
+ * it can be shared between threads without further copies.  Object,
+ * text, path segment nodes and binary host data share a single
+ * allocation.  The object starts with a reference count of one;
+ * more references are taken using uriFrozenUriRetainA and each one is
+ * dropped using uriFrozenUriReleaseMmA with the same memory manager.
+ * The %URI in <c>(*dest)->uri</c> can be passed to any function that
+ * does not modify a %URI, e.g. uriToStringA or uriEqualsUriA.
+ *
+ * Reference counting is atomic, using builtins of GCC, Clang or MSVC
+ * or else C11 atomics; the library does not build without either.
+ *
+ * @param dest    <b>OUT</b>: Output destination, holds one reference
+ * @param source  <b>IN</b>: %URI to freeze
+ * @param memory  <b>IN</b>: Memory manager to use, NULL for default libc
+ * @return        Error code or 0 on success
+ *
+ * @see uriFreezeUriA
+ * @see uriFrozenUriRetainA
+ * @see uriFrozenUriReleaseMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(FreezeUriMm)(const URI_TYPE(FrozenUri) ** dest,
+		const URI_TYPE(Uri) * source, UriMemoryManager * memory);
+
+
+
+/**
+ * Takes another reference to a frozen %URI; safe to call from
+ * any thread holding a reference already.
+ *
+ * @param frozen  <b>IN</b>: Frozen %URI or NULL
+ * @return        <c>frozen</c>
+ *
+ * @see uriFreezeUriMmA
+ * @see uriFrozenUriReleaseMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC const URI_TYPE(FrozenUri) * URI_FUNC(FrozenUriRetain)(
+		const URI_TYPE(FrozenUri) * frozen);
+
+
+
+/**
+ * Drops a reference to a frozen %URI, releasing it when
+ * it was the last one; safe to call from any thread.
+ * Uses default libc-based memory manager.
+ *
+ * @param frozen  <b>IN</b>: Frozen %URI or NULL
+ *
+ * @see uriFrozenUriReleaseMmA
+ * @see uriFreezeUriA
+ * @since 0.9.9
+ */
+URI_PUBLIC void URI_FUNC(FrozenUriRelease)(const URI_TYPE(FrozenUri) * frozen);
+
+
+
+/**
+ * Drops a reference to a frozen %URI, releasing it when
+ * it was the last one; safe to call from any thread.
+ *
+ * @param frozen  <b>IN</b>: Frozen %URI or NULL
+ * @param memory  <b>IN</b>: Memory manager the %URI was frozen with, NULL for default libc
+ * @return        Error code or 0 on success
+ *
+ * @see uriFrozenUriReleaseA
+ * @see uriFreezeUriMmA
+ * @since 0.9.9
+ */
+URI_PUBLIC int URI_FUNC(FrozenUriReleaseMm)(const URI_TYPE(FrozenUri) * frozen,
+		UriMemoryManager * memory);
+
+
+
 #ifdef __cplusplus
 }
 #endif
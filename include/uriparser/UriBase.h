@@ -148,6 +148,9 @@ typedef int UriBool; /**< Boolean type */
 /* Error specific to uriTestMemoryManager */
 #define URI_ERROR_MEMORY_MANAGER_FAULTY   11 /* [>=0.9.0] The UriMemoryManager given did not pass the test suite */
 
+/* Error specific to uriGetMemoryStats and uriResetMemoryStats */
+#define URI_ERROR_MEMORY_MANAGER_NOT_ACCOUNTING  12 /* [>=0.9.9] The UriMemoryManager given was not set up by uriAccountMemoryManager */
+
 
 #ifndef URI_DOXYGEN
 # include <stdio.h> /* For NULL, snprintf */
@@ -233,6 +236,91 @@ typedef struct UriMemoryManagerStruct {
 } UriMemoryManager; /**< @copydoc UriMemoryManagerStruct */
 
 
+/**
+ * Kinds of objects the library allocates memory for,
+ * passed to sized memory manager backends as a hint.
+ *
+ * @see UriSizedMemoryBackend
+ * @since 0.9.9
+ */
+typedef enum UriMemoryKindEnum {
+	URI_MEMORY_UNKNOWN = 0, /**< Anything else, e.g. buffers handed out to the application */
+	URI_MEMORY_TEXT, /**< Text of %URI components, query keys or query values */
+	URI_MEMORY_PATH_SEGMENT, /**< A single path segment node (UriPathSegmentA/UriPathSegmentW) */
+	URI_MEMORY_HOST_DATA, /**< A binary IP address (UriIp4/UriIp6) */
+	URI_MEMORY_QUERY_LIST /**< A single query list node (UriQueryListA/UriQueryListW) */
+} UriMemoryKind; /**< @copydoc UriMemoryKindEnum */
+
+
+struct UriSizedMemoryBackendStruct;  /* foward declaration to break loop */
+
+
+/**
+ * Function signature that malloc(3)-like functions of
+ * sized memory manager backends must conform to
+ *
+ * @since 0.9.9
+ */
+typedef void * (*UriFuncSizedMalloc)(struct UriSizedMemoryBackendStruct *, size_t, UriMemoryKind);
+
+/**
+ * Function signature that free(3)-like functions of
+ * sized memory manager backends must conform to;
+ * receives the size and kind passed at allocation time
+ *
+ * @since 0.9.9
+ */
+typedef void (*UriFuncSizedFree)(struct UriSizedMemoryBackendStruct *, void *, size_t, UriMemoryKind);
+
+
+/**
+ * Memory manager backend that gets told the size and kind of memory
+ * on release, e.g. a slab or arena allocator that would otherwise
+ * need to keep a size header per allocation.
+ *
+ * @see uriCompleteSizedMemoryManager
+ * @since 0.9.9
+ */
+typedef struct UriSizedMemoryBackendStruct {
+	UriFuncSizedMalloc malloc; /**< Pointer to custom malloc(3)-like function */
+	UriFuncSizedFree free; /**< Pointer to custom free(3)-like function */
+	void * userData; /**< Pointer to data that the other function members need access to */
+} UriSizedMemoryBackend; /**< @copydoc UriSizedMemoryBackendStruct */
+
+
+/**
+ * Allocation statistics collected by a memory manager
+ * set up using uriAccountMemoryManager.
+ *
+ * @see uriAccountMemoryManager
+ * @see uriGetMemoryStats
+ * @since 0.9.9
+ */
+typedef struct UriMemoryStatsStruct {
+	size_t bytesCurrent; /**< Number of bytes currently allocated, excluding bookkeeping overhead */
+	size_t bytesPeak; /**< Highest value bytesCurrent has reached so far */
+	size_t mallocCalls; /**< Number of calls to malloc */
+	size_t callocCalls; /**< Number of calls to calloc */
+	size_t reallocCalls; /**< Number of calls to realloc */
+	size_t reallocarrayCalls; /**< Number of calls to reallocarray */
+	size_t freeCalls; /**< Number of calls to free, including those passing NULL */
+	size_t failedCalls; /**< Number of allocation requests that could not be served */
+} UriMemoryStats; /**< @copydoc UriMemoryStatsStruct */
+
+
+/**
+ * State of a memory manager set up using uriAccountMemoryManager.
+ * Has to outlive all allocations made through that memory manager.
+ *
+ * @see uriAccountMemoryManager
+ * @since 0.9.9
+ */
+typedef struct UriMemoryAccountingStruct {
+	UriMemoryManager * backend; /**< Memory manager doing the actual work */
+	UriMemoryStats stats; /**< Statistics collected so far */
+} UriMemoryAccounting; /**< @copydoc UriMemoryAccountingStruct */
+
+
 /**
  * Specifies a line break conversion mode.
  */
@@ -250,6 +338,15 @@ typedef enum UriBreakConversionEnum {
 
 /**
  * Specifies which component of a %URI has to be normalized.
+ *
+ * The flags from ::URI_NORMALIZE_PORT on go beyond syntax-based
+ * normalization and are only applied when passed explicitly:
+ * a mask with any bit set that none of these flags cover,
+ * e.g. <c>(unsigned int)-1</c> or <c>~URI_NORMALIZE_FRAGMENT</c>,
+ * keeps standing for syntax-based normalization of the components
+ * it selects.  Likewise, they are only reported
+ * by uriNormalizeMaskRequiredA when asked for, never by
+ * uriNormalizeSyntaxMaskRequiredExA.
  */
 typedef enum UriNormalizationMaskEnum {
 	URI_NORMALIZED = 0, /**< Do not normalize anything */
@@ -258,11 +355,68 @@ typedef enum UriNormalizationMaskEnum {
 	URI_NORMALIZE_HOST = 1 << 2, /**< Normalize host (fix uppercase letters) */
 	URI_NORMALIZE_PATH = 1 << 3, /**< Normalize path (fix uppercase percent-encodings and redundant dot segments) */
 	URI_NORMALIZE_QUERY = 1 << 4, /**< Normalize query (fix uppercase percent-encodings) */
-	URI_NORMALIZE_FRAGMENT = 1 << 5 /**< Normalize fragment (fix uppercase percent-encodings) */
+	URI_NORMALIZE_FRAGMENT = 1 << 5, /**< Normalize fragment (fix uppercase percent-encodings) */
+	URI_NORMALIZE_PORT = 1 << 6, /**< Drop an empty port or the default port of the scheme, scheme-based (since 0.9.9) */
+	URI_NORMALIZE_EMPTY_PATH = 1 << 7, /**< Turn an empty path into "/" for http, https, ws and wss, scheme-based (since 0.9.9) */
+	URI_NORMALIZE_EMPTY_QUERY = 1 << 8, /**< Drop an empty query, changes semantics for some servers (since 0.9.9) */
+	URI_NORMALIZE_DROP_FRAGMENT = 1 << 9 /**< Drop the fragment, changes semantics (since 0.9.9) */
 } UriNormalizationMask; /**< @copydoc UriNormalizationMaskEnum */
 
 
 
+/**
+ * Maximum number of keys a query key set can hold.
+ *
+ * @see uriQueryKeySetInitA
+ * @since 0.9.9
+ */
+#define URI_QUERY_KEY_SET_MAX_KEYS  32
+
+/**
+ * Number of hash slots in a query key set, a power of two
+ * of at least twice #URI_QUERY_KEY_SET_MAX_KEYS.
+ *
+ * @since 0.9.9
+ */
+#define URI_QUERY_KEY_SET_SLOTS  64
+
+
+
+/**
+ * Specifies what to drop when canonicalizing a query.
+ *
+ * @see uriCanonicalizeQueryMallocA
+ * @since 0.9.9
+ */
+typedef enum UriQueryCanonicalizationOptionsEnum {
+	URI_QUERY_CANONICAL_KEEP_ALL = 0, /**< Only reorder and normalize percent-encodings */
+	URI_QUERY_CANONICAL_DROP_EMPTY = 1 << 0, /**< Drop items with an empty key or an empty value, e.g. "=1" or "a=" but not "a" */
+	URI_QUERY_CANONICAL_DROP_DUPLICATES = 1 << 1 /**< Drop items repeating both key and value of an earlier item */
+} UriQueryCanonicalizationOptions; /**< @copydoc UriQueryCanonicalizationOptionsEnum */
+
+
+
+/**
+ * Specifies which characters to keep literally when percent-encoding
+ * text for a particular %URI component.
+ * Percent signs, spaces, line breaks and characters outside of
+ * RFC 3986 are always encoded.
+ *
+ * @see uriEscapeComponentA
+ * @since 0.9.9
+ */
+typedef enum UriEscapeModeEnum {
+	URI_ESCAPE_UNRESERVED = 0, /**< Keep unreserved characters only, same as uriEscapeExA */
+	URI_ESCAPE_USER_INFO, /**< Keep unreserved characters, sub-delims and ':' */
+	URI_ESCAPE_PATH_SEGMENT, /**< Keep unreserved characters, sub-delims, ':' and '@' */
+	URI_ESCAPE_PATH, /**< Like #URI_ESCAPE_PATH_SEGMENT, also keep '/' */
+	URI_ESCAPE_QUERY, /**< Keep unreserved characters, sub-delims, ':', '@', '/' and '?' */
+	URI_ESCAPE_QUERY_PARAM, /**< Like #URI_ESCAPE_QUERY, but encode '&', '=' and '+' */
+	URI_ESCAPE_FRAGMENT /**< Same characters as #URI_ESCAPE_QUERY */
+} UriEscapeMode; /**< @copydoc UriEscapeModeEnum */
+
+
+
 /**
  * Specifies how to resolve %URI references.
  */
@@ -307,6 +461,38 @@ URI_PUBLIC int uriCompleteMemoryManager(UriMemoryManager * memory,
 
 
 
+/**
+ * Wraps a sized memory manager backend to make a complete memory manager
+ * ready to be used.
+ *
+ * Path segments, query list nodes and binary IP addresses are
+ * allocated from the backend with their exact size and no extra bytes
+ * and released through backend->free with that very size, so that
+ * the backend can serve them from pools picked by kind and alignment
+ * is entirely up to the backend.
+ * All other allocations (e.g. text, or memory->malloc called by the
+ * application) carry a header of 2 * sizeof(size_t) bytes
+ * so that backend->free still receives their size and kind.
+ *
+ * Nodes allocated by the library must be released by the library
+ * (e.g. by uriFreeUriMembersMmA) rather than through memory->free;
+ * likewise path segments and query list nodes created by the application
+ * must not be handed to the library for release.
+ *
+ * @param memory   <b>OUT</b>: Where to write the wrapped memory manager to
+ * @param backend  <b>IN</b>: Sized memory manager to use as a backend; must outlive <c>memory</c>
+ * @return          Error code or 0 on success
+ *
+ * @see uriCompleteMemoryManager
+ * @see UriSizedMemoryBackend
+ * @see UriMemoryManager
+ * @since 0.9.9
+ */
+URI_PUBLIC int uriCompleteSizedMemoryManager(UriMemoryManager * memory,
+		UriSizedMemoryBackend * backend);
+
+
+
 /**
  * Offers emulation of calloc(3) based on memory->malloc and memset.
  * See "man 3 calloc" as well.
@@ -370,4 +556,68 @@ URI_PUBLIC int uriTestMemoryManager(UriMemoryManager * memory);
 
 
 
+/**
+ * Wraps a complete memory manager backend to make a memory manager
+ * that keeps track of the number of bytes currently allocated,
+ * the peak number of bytes allocated, and the number of calls made
+ * to each of its functions.  The statistics can be queried using
+ * uriGetMemoryStats at any time, e.g. to enforce a memory budget
+ * per request or to compare allocation behavior between versions.
+ *
+ * Every allocation carries sizeof(size_t) extra bytes of bookkeeping
+ * that are not accounted for in the statistics.  Memory allocated
+ * through the wrapped memory manager must be released through it as well,
+ * not through the backend.
+ *
+ * @param memory      <b>OUT</b>: Where to write the wrapped memory manager to
+ * @param accounting  <b>OUT</b>: Where to keep state; must outlive <c>memory</c>
+ * @param backend     <b>IN</b>: Complete memory manager to use as a backend
+ * @return            Error code or 0 on success
+ *
+ * @see uriGetMemoryStats
+ * @see uriResetMemoryStats
+ * @see uriCompleteMemoryManager
+ * @see UriMemoryManager
+ * @since 0.9.9
+ */
+URI_PUBLIC int uriAccountMemoryManager(UriMemoryManager * memory,
+		UriMemoryAccounting * accounting, UriMemoryManager * backend);
+
+
+
+/**
+ * Copies the statistics collected by a memory manager
+ * set up using uriAccountMemoryManager.
+ *
+ * @param memory  <b>IN</b>: Memory manager set up using uriAccountMemoryManager
+ * @param stats   <b>OUT</b>: Where to write the statistics to
+ * @return        Error code or 0 on success
+ *
+ * @see uriAccountMemoryManager
+ * @see uriResetMemoryStats
+ * @since 0.9.9
+ */
+URI_PUBLIC int uriGetMemoryStats(const UriMemoryManager * memory,
+		UriMemoryStats * stats);
+
+
+
+/**
+ * Resets the call counters of a memory manager set up using
+ * uriAccountMemoryManager to zero and its peak to the number
+ * of bytes currently allocated.  Bytes still allocated remain
+ * accounted for so that releasing them later keeps the
+ * statistics consistent.
+ *
+ * @param memory  <b>INOUT</b>: Memory manager set up using uriAccountMemoryManager
+ * @return        Error code or 0 on success
+ *
+ * @see uriAccountMemoryManager
+ * @see uriGetMemoryStats
+ * @since 0.9.9
+ */
+URI_PUBLIC int uriResetMemoryStats(UriMemoryManager * memory);
+
+
+
 #endif /* URI_BASE_H */
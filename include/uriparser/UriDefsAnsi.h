@@ -72,6 +72,8 @@
 #define URI_STRCMP strcmp
 #undef URI_STRNCMP
 #define URI_STRNCMP strncmp
+#undef URI_MEMCHR
+#define URI_MEMCHR memchr
 
 /* TODO Remove on next source-compatibility break */
 #undef URI_SNPRINTF
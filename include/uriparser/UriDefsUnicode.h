@@ -72,6 +72,8 @@
 #define URI_STRCMP wcscmp
 #undef URI_STRNCMP
 #define URI_STRNCMP wcsncmp
+#undef URI_MEMCHR
+#define URI_MEMCHR wmemchr
 
 /* TODO Remove on next source-compatibility break */
 #undef URI_SNPRINTF
@@ -64,6 +64,7 @@
 #ifndef URI_DOXYGEN
 # include <uriparser/Uri.h>
 # include "UriCommon.h"
+# include "UriMemory.h"
 #endif
 
 
@@ -126,6 +127,11 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 		return URI_TRUE;
 	}
 
+	if (uri->reserved != NULL) {
+		/* Text lives in a single block, see uriNormalizeSyntaxExMmA */
+		pathOwned = URI_FALSE;
+	}
+
 	walker = uri->pathHead;
 	walker->reserved = NULL; /* Prev pointer */
 	do {
@@ -180,7 +186,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 						if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 							memory->free(memory, (URI_CHAR *)walker->text.first);
 						}
-						memory->free(memory, walker);
+						URI_FUNC(FreePathSegmentNode)(uri, walker, memory);
 					} else {
 						/* Last segment */
 						if (pathOwned && (walker->text.first != walker->text.afterLast)) {
@@ -194,7 +200,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 								walker->text.first = URI_FUNC(SafeToPointTo);
 								walker->text.afterLast = URI_FUNC(SafeToPointTo);
 							} else {
-								memory->free(memory, walker);
+								URI_FUNC(FreePathSegmentNode)(uri, walker, memory);
 
 								uri->pathHead = NULL;
 								uri->pathTail = NULL;
@@ -252,17 +258,17 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 								walker->next->reserved = prevPrev;
 							} else {
 								/* Last segment -> insert "" segment to represent trailing slash, update tail */
-								URI_TYPE(PathSegment) * const segment = memory->calloc(memory, 1, sizeof(URI_TYPE(PathSegment)));
+								URI_TYPE(PathSegment) * const segment = uriCallocNode(memory, sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
 								if (segment == NULL) {
 									if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 										memory->free(memory, (URI_CHAR *)walker->text.first);
 									}
-									memory->free(memory, walker);
+									URI_FUNC(FreePathSegmentNode)(uri, walker, memory);
 
 									if (pathOwned && (prev->text.first != prev->text.afterLast)) {
 										memory->free(memory, (URI_CHAR *)prev->text.first);
 									}
-									memory->free(memory, prev);
+									URI_FUNC(FreePathSegmentNode)(uri, prev, memory);
 
 									return URI_FALSE; /* Raises malloc error */
 								}
@@ -275,12 +281,12 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 							if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 								memory->free(memory, (URI_CHAR *)walker->text.first);
 							}
-							memory->free(memory, walker);
+							URI_FUNC(FreePathSegmentNode)(uri, walker, memory);
 
 							if (pathOwned && (prev->text.first != prev->text.afterLast)) {
 								memory->free(memory, (URI_CHAR *)prev->text.first);
 							}
-							memory->free(memory, prev);
+							URI_FUNC(FreePathSegmentNode)(uri, prev, memory);
 
 							walker = nextBackup;
 						} else {
@@ -292,7 +298,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 								if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 									memory->free(memory, (URI_CHAR *)walker->text.first);
 								}
-								memory->free(memory, walker);
+								URI_FUNC(FreePathSegmentNode)(uri, walker, memory);
 							} else {
 								/* Re-use segment for "" path segment to represent trailing slash, update tail */
 								URI_TYPE(PathSegment) * const segment = walker;
@@ -308,7 +314,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 							if (pathOwned && (prev->text.first != prev->text.afterLast)) {
 								memory->free(memory, (URI_CHAR *)prev->text.first);
 							}
-							memory->free(memory, prev);
+							URI_FUNC(FreePathSegmentNode)(uri, prev, memory);
 
 							walker = nextBackup;
 						}
@@ -354,7 +360,7 @@ UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 							if (pathOwned && (walker->text.first != walker->text.afterLast)) {
 								memory->free(memory, (URI_CHAR *)walker->text.first);
 							}
-							memory->free(memory, walker);
+							URI_FUNC(FreePathSegmentNode)(uri, walker, memory);
 						}
 
 						walker = anotherNextBackup;
@@ -393,6 +399,15 @@ UriBool URI_FUNC(RemoveDotSegmentsAbsolute)(URI_TYPE(Uri) * uri,
 
 
 
+UriBool URI_FUNC(IsHexdig)(URI_CHAR candidate) {
+	return (((candidate >= _UT('0')) && (candidate <= _UT('9')))
+			|| ((candidate >= _UT('a')) && (candidate <= _UT('f')))
+			|| ((candidate >= _UT('A')) && (candidate <= _UT('F'))))
+			? URI_TRUE : URI_FALSE;
+}
+
+
+
 unsigned char URI_FUNC(HexdigToInt)(URI_CHAR hexdig) {
 	switch (hexdig) {
 	case _UT('0'):
@@ -462,6 +477,17 @@ URI_CHAR URI_FUNC(HexToLetterEx)(unsigned int value, UriBool uppercase) {
 
 
 
+/* Releases a path segment node unless it lives in the URI's block */
+void URI_FUNC(FreePathSegmentNode)(const URI_TYPE(Uri) * uri,
+		URI_TYPE(PathSegment) * segment, UriMemoryManager * memory) {
+	if (!uriBlockContains((const UriBlock *)uri->reserved, segment)) {
+		uriFreeNode(memory, segment, sizeof(URI_TYPE(PathSegment)),
+				URI_MEMORY_PATH_SEGMENT);
+	}
+}
+
+
+
 /* Checks if a URI has the host component set. */
 UriBool URI_FUNC(IsHostSet)(const URI_TYPE(Uri) * uri) {
 	return (uri != NULL)
@@ -486,7 +512,7 @@ UriBool URI_FUNC(CopyPath)(URI_TYPE(Uri) * dest,
 		URI_TYPE(PathSegment) * sourceWalker = source->pathHead;
 		URI_TYPE(PathSegment) * destPrev = NULL;
 		do {
-			URI_TYPE(PathSegment) * cur = memory->malloc(memory, sizeof(URI_TYPE(PathSegment)));
+			URI_TYPE(PathSegment) * cur = uriMallocNode(memory, sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
 			if (cur == NULL) {
 				/* Fix broken list */
 				if (destPrev != NULL) {
@@ -531,7 +557,7 @@ UriBool URI_FUNC(CopyAuthority)(URI_TYPE(Uri) * dest,
 
 	/* Copy hostData */
 	if (source->hostData.ip4 != NULL) {
-		dest->hostData.ip4 = memory->malloc(memory, sizeof(UriIp4));
+		dest->hostData.ip4 = uriMallocNode(memory, sizeof(UriIp4), URI_MEMORY_HOST_DATA);
 		if (dest->hostData.ip4 == NULL) {
 			return URI_FALSE; /* Raises malloc error */
 		}
@@ -541,7 +567,7 @@ UriBool URI_FUNC(CopyAuthority)(URI_TYPE(Uri) * dest,
 		dest->hostData.ipFuture.afterLast = NULL;
 	} else if (source->hostData.ip6 != NULL) {
 		dest->hostData.ip4 = NULL;
-		dest->hostData.ip6 = memory->malloc(memory, sizeof(UriIp6));
+		dest->hostData.ip6 = uriMallocNode(memory, sizeof(UriIp6), URI_MEMORY_HOST_DATA);
 		if (dest->hostData.ip6 == NULL) {
 			return URI_FALSE; /* Raises malloc error */
 		}
@@ -582,7 +608,7 @@ UriBool URI_FUNC(FixAmbiguity)(URI_TYPE(Uri) * uri,
 		return URI_TRUE;
 	}
 
-	segment = memory->malloc(memory, 1 * sizeof(URI_TYPE(PathSegment)));
+	segment = uriMallocNode(memory, sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
 	if (segment == NULL) {
 		return URI_FALSE; /* Raises malloc error */
 	}
@@ -605,7 +631,7 @@ void URI_FUNC(FixEmptyTrailSegment)(URI_TYPE(Uri) * uri,
 			&& (uri->pathHead != NULL)
 			&& (uri->pathHead->next == NULL)
 			&& (uri->pathHead->text.first == uri->pathHead->text.afterLast)) {
-		memory->free(memory, uri->pathHead);
+		URI_FUNC(FreePathSegmentNode)(uri, uri->pathHead, memory);
 		uri->pathHead = NULL;
 		uri->pathTail = NULL;
 	}
@@ -77,6 +77,8 @@ extern const URI_CHAR * const URI_FUNC(ConstParent);
 
 
 void URI_FUNC(ResetUri)(URI_TYPE(Uri) * uri);
+void URI_FUNC(FreePathSegmentNode)(const URI_TYPE(Uri) * uri,
+		URI_TYPE(PathSegment) * segment, UriMemoryManager * memory);
 
 int URI_FUNC(CompareRange)(
 		const URI_TYPE(TextRange) * a,
@@ -87,11 +89,25 @@ UriBool URI_FUNC(RemoveDotSegmentsAbsolute)(URI_TYPE(Uri) * uri,
 UriBool URI_FUNC(RemoveDotSegmentsEx)(URI_TYPE(Uri) * uri,
 		UriBool relative, UriBool pathOwned, UriMemoryManager * memory);
 
+void URI_FUNC(FixPercentEncodingEngine)(
+		const URI_CHAR * inFirst, const URI_CHAR * inAfterLast,
+		const URI_CHAR * outFirst, const URI_CHAR ** outAfterLast,
+		UriBool lowercase);
+void URI_FUNC(LowercaseInplace)(const URI_CHAR * first,
+		const URI_CHAR * afterLast);
+
+size_t URI_FUNC(EscapedLength)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast,
+		UriBool spaceToPlus, UriBool normalizeBreaks);
+
+UriBool URI_FUNC(IsHexdig)(URI_CHAR candidate);
 unsigned char URI_FUNC(HexdigToInt)(URI_CHAR hexdig);
 URI_CHAR URI_FUNC(HexToLetter)(unsigned int value);
 URI_CHAR URI_FUNC(HexToLetterEx)(unsigned int value, UriBool uppercase);
 
 UriBool URI_FUNC(IsHostSet)(const URI_TYPE(Uri) * uri);
+UriBool URI_FUNC(IsPortRedundant)(const URI_TYPE(Uri) * uri);
+UriBool URI_FUNC(IsEmptyPathRoot)(const URI_TYPE(Uri) * uri);
 
 UriBool URI_FUNC(CopyPath)(URI_TYPE(Uri) * dest, const URI_TYPE(Uri) * source,
 		UriMemoryManager * memory);
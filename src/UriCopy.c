@@ -0,0 +1,318 @@
+/*
+ * uriparser - RFC 3986 URI parsing library
+ *
+ * Copyright (C) 2007, Weijia Song <songweijia@gmail.com>
+ * Copyright (C) 2007, Sebastian Pipping <sebastian@pipping.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source  and binary forms, with or without
+ * modification, are permitted provided  that the following conditions
+ * are met:
+ *
+ *     1. Redistributions  of  source  code   must  retain  the  above
+ *        copyright notice, this list  of conditions and the following
+ *        disclaimer.
+ *
+ *     2. Redistributions  in binary  form  must  reproduce the  above
+ *        copyright notice, this list  of conditions and the following
+ *        disclaimer  in  the  documentation  and/or  other  materials
+ *        provided with the distribution.
+ *
+ *     3. Neither the  name of the  copyright holder nor the  names of
+ *        its contributors may be used  to endorse or promote products
+ *        derived from  this software  without specific  prior written
+ *        permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND  ANY EXPRESS OR IMPLIED WARRANTIES,  INCLUDING, BUT NOT
+ * LIMITED TO,  THE IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS
+ * FOR  A  PARTICULAR  PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL
+ * THE  COPYRIGHT HOLDER  OR CONTRIBUTORS  BE LIABLE  FOR ANY  DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA,  OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT  LIABILITY,  OR  TORT (INCLUDING  NEGLIGENCE  OR  OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* What encodings are enabled? */
+#include <uriparser/UriDefsConfig.h>
+#if (!defined(URI_PASS_ANSI) && !defined(URI_PASS_UNICODE))
+/* Include SELF twice */
+# ifdef URI_ENABLE_ANSI
+#  define URI_PASS_ANSI 1
+#  include "UriCopy.c"
+#  undef URI_PASS_ANSI
+# endif
+# ifdef URI_ENABLE_UNICODE
+#  define URI_PASS_UNICODE 1
+#  include "UriCopy.c"
+#  undef URI_PASS_UNICODE
+# endif
+#else
+# ifdef URI_PASS_ANSI
+#  include <uriparser/UriDefsAnsi.h>
+# else
+#  include <uriparser/UriDefsUnicode.h>
+#  include <wchar.h>
+# endif
+
+
+
+#ifndef URI_DOXYGEN
+# include <uriparser/Uri.h>
+# include <uriparser/UriIp4.h>
+# include "UriCommon.h"
+# include "UriMemory.h"
+#endif
+
+
+
+#include <string.h>
+
+
+
+static URI_INLINE size_t URI_FUNC(RangeLength)(const URI_TYPE(TextRange) * range) {
+	return (range->first == NULL) ? 0 : (size_t)(range->afterLast - range->first);
+}
+
+
+
+/* Copies a range to *write and advances *write; a NULL range stays NULL */
+static URI_INLINE void URI_FUNC(CopyRangeRebased)(URI_TYPE(TextRange) * dest,
+		const URI_TYPE(TextRange) * source, URI_CHAR ** write) {
+	const size_t lenInChars = URI_FUNC(RangeLength)(source);
+
+	if (source->first == NULL) {
+		dest->first = NULL;
+		dest->afterLast = NULL;
+		return;
+	}
+
+	if (lenInChars > 0) {
+		memcpy(*write, source->first, lenInChars * sizeof(URI_CHAR));
+	}
+	dest->first = *write;
+	dest->afterLast = *write + lenInChars;
+	*write += lenInChars;
+}
+
+
+
+/* Copies source into a single block, optionally preceded by prefixSize
+ * bytes for the caller at *prefix; dest is only written on success */
+static int URI_FUNC(CopyUriEngine)(URI_TYPE(Uri) * dest,
+		const URI_TYPE(Uri) * source, size_t prefixSize, void ** prefix,
+		UriMemoryManager * memory) {
+	URI_TYPE(Uri) copy;
+	const URI_TYPE(PathSegment) * walker;
+	URI_TYPE(PathSegment) * segments;
+	size_t segmentCount = 0;
+	size_t lenInChars;
+	size_t dataSize;
+	UriBool hostSharesIpFuture;
+	UriBlock * block;
+	URI_CHAR * write;
+	unsigned char * hostDataWrite;
+	size_t i;
+
+	/* NOTE: The parser stores IPvFuture host text twice,
+	 *       once as .hostText and once as .hostData.ipFuture */
+	hostSharesIpFuture = ((source->hostData.ipFuture.first != NULL)
+			&& (source->hostText.first == source->hostData.ipFuture.first)
+			&& (source->hostText.afterLast == source->hostData.ipFuture.afterLast))
+			? URI_TRUE : URI_FALSE;
+
+	/* Measure */
+	lenInChars = URI_FUNC(RangeLength)(&(source->scheme))
+			+ URI_FUNC(RangeLength)(&(source->userInfo))
+			+ URI_FUNC(RangeLength)(&(source->hostData.ipFuture))
+			+ (hostSharesIpFuture ? 0 : URI_FUNC(RangeLength)(&(source->hostText)))
+			+ URI_FUNC(RangeLength)(&(source->portText))
+			+ URI_FUNC(RangeLength)(&(source->query))
+			+ URI_FUNC(RangeLength)(&(source->fragment));
+	for (walker = source->pathHead; walker != NULL; walker = walker->next) {
+		lenInChars += URI_FUNC(RangeLength)(&(walker->text));
+		segmentCount++;
+	}
+
+	/* Layout is [prefix][path segment nodes][text][host data]
+	 * so that every part is suitably aligned */
+	if ((segmentCount > ((size_t)-1) / sizeof(URI_TYPE(PathSegment)))
+			|| (lenInChars > ((size_t)-1) / sizeof(URI_CHAR))) {
+		return URI_ERROR_MALLOC;
+	}
+	dataSize = prefixSize + segmentCount * sizeof(URI_TYPE(PathSegment));
+	if ((dataSize < prefixSize) || (lenInChars * sizeof(URI_CHAR)
+			> ((size_t)-1) - dataSize - sizeof(UriIp4) - sizeof(UriIp6))) {
+		return URI_ERROR_MALLOC;
+	}
+	dataSize += lenInChars * sizeof(URI_CHAR)
+			+ ((source->hostData.ip4 != NULL) ? sizeof(UriIp4) : 0)
+			+ ((source->hostData.ip6 != NULL) ? sizeof(UriIp6) : 0);
+
+	block = uriMallocBlock(memory, dataSize, URI_MEMORY_TEXT);
+	if (block == NULL) {
+		return URI_ERROR_MALLOC;
+	}
+	if (prefix != NULL) {
+		*prefix = URI_BLOCK_DATA(block);
+	}
+	segments = (URI_TYPE(PathSegment) *)((char *)URI_BLOCK_DATA(block) + prefixSize);
+	write = (URI_CHAR *)(segments + segmentCount);
+	hostDataWrite = (unsigned char *)(write + lenInChars);
+
+	memset(&copy, 0, sizeof(URI_TYPE(Uri)));
+
+	/* Text */
+	URI_FUNC(CopyRangeRebased)(&(copy.scheme), &(source->scheme), &write);
+	URI_FUNC(CopyRangeRebased)(&(copy.userInfo), &(source->userInfo), &write);
+	URI_FUNC(CopyRangeRebased)(&(copy.hostData.ipFuture),
+			&(source->hostData.ipFuture), &write);
+	if (hostSharesIpFuture) {
+		copy.hostText = copy.hostData.ipFuture;
+	} else {
+		URI_FUNC(CopyRangeRebased)(&(copy.hostText), &(source->hostText), &write);
+	}
+	URI_FUNC(CopyRangeRebased)(&(copy.portText), &(source->portText), &write);
+
+	/* Path */
+	for (walker = source->pathHead, i = 0; walker != NULL;
+			walker = walker->next, i++) {
+		URI_FUNC(CopyRangeRebased)(&(segments[i].text), &(walker->text), &write);
+		segments[i].next = (i + 1 < segmentCount) ? segments + i + 1 : NULL;
+		segments[i].reserved = NULL;
+	}
+	if (segmentCount > 0) {
+		copy.pathHead = segments;
+		copy.pathTail = segments + segmentCount - 1;
+	}
+
+	URI_FUNC(CopyRangeRebased)(&(copy.query), &(source->query), &write);
+	URI_FUNC(CopyRangeRebased)(&(copy.fragment), &(source->fragment), &write);
+
+	/* Host data */
+	if (source->hostData.ip4 != NULL) {
+		copy.hostData.ip4 = (UriIp4 *)hostDataWrite;
+		memcpy(copy.hostData.ip4, source->hostData.ip4, sizeof(UriIp4));
+		hostDataWrite += sizeof(UriIp4);
+	}
+	if (source->hostData.ip6 != NULL) {
+		copy.hostData.ip6 = (UriIp6 *)hostDataWrite;
+		memcpy(copy.hostData.ip6, source->hostData.ip6, sizeof(UriIp6));
+	}
+
+	copy.absolutePath = source->absolutePath;
+	copy.owner = URI_TRUE;
+	copy.reserved = block;
+
+	*dest = copy;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(CopyUri)(URI_TYPE(Uri) * dest, const URI_TYPE(Uri) * source) {
+	return URI_FUNC(CopyUriMm)(dest, source, NULL);
+}
+
+
+
+int URI_FUNC(CopyUriMm)(URI_TYPE(Uri) * dest, const URI_TYPE(Uri) * source,
+		UriMemoryManager * memory) {
+	if ((dest == NULL) || (source == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	return URI_FUNC(CopyUriEngine)(dest, source, 0, NULL, memory);
+}
+
+
+
+int URI_FUNC(FreezeUri)(const URI_TYPE(FrozenUri) ** dest,
+		const URI_TYPE(Uri) * source) {
+	return URI_FUNC(FreezeUriMm)(dest, source, NULL);
+}
+
+
+
+int URI_FUNC(FreezeUriMm)(const URI_TYPE(FrozenUri) ** dest,
+		const URI_TYPE(Uri) * source, UriMemoryManager * memory) {
+	URI_TYPE(FrozenUri) * frozen;
+	URI_TYPE(Uri) copy;
+	UriBlock * block;
+	void * prefix;
+	int charsRequired;
+	int res;
+
+	if ((dest == NULL) || (source == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	res = URI_FUNC(CopyUriEngine)(&copy, source,
+			sizeof(URI_TYPE(FrozenUri)), &prefix, memory);
+	if (res != URI_SUCCESS) {
+		return res;
+	}
+	frozen = prefix;
+	block = (UriBlock *)copy.reserved;
+
+	frozen->uri = copy;
+	frozen->refCount = 1;
+
+	/* Immutable, so the length of its text can be cached
+	 * for uriToStringCharsRequiredA and uriToStringMallocA */
+	res = URI_FUNC(ToStringCharsRequired)(&(frozen->uri), &charsRequired);
+	if (res != URI_SUCCESS) {
+		uriFreeBlock(memory, block);
+		return res;
+	}
+	block->charsRequired = charsRequired;
+
+	*dest = frozen;
+	return URI_SUCCESS;
+}
+
+
+
+const URI_TYPE(FrozenUri) * URI_FUNC(FrozenUriRetain)(
+		const URI_TYPE(FrozenUri) * frozen) {
+	if (frozen != NULL) {
+		uriRefCountIncrement(&(((URI_TYPE(FrozenUri) *)frozen)->refCount));
+	}
+	return frozen;
+}
+
+
+
+void URI_FUNC(FrozenUriRelease)(const URI_TYPE(FrozenUri) * frozen) {
+	URI_FUNC(FrozenUriReleaseMm)(frozen, NULL);
+}
+
+
+
+int URI_FUNC(FrozenUriReleaseMm)(const URI_TYPE(FrozenUri) * frozen,
+		UriMemoryManager * memory) {
+	if (frozen == NULL) {
+		return URI_SUCCESS;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	if (uriRefCountDecrement(&(((URI_TYPE(FrozenUri) *)frozen)->refCount)) == 0) {
+		/* The object itself lives in the block it refers to */
+		uriFreeBlock(memory, (UriBlock *)frozen->uri.reserved);
+	}
+	return URI_SUCCESS;
+}
+
+
+
+#endif
@@ -64,10 +64,16 @@
 #ifndef URI_DOXYGEN
 # include <uriparser/Uri.h>
 # include "UriCommon.h"
+# include "UriEscapeBase.h"
 #endif
 
 
 
+#include <limits.h>
+#include <string.h> /* memcpy, memmove, memchr */
+
+
+
 URI_CHAR * URI_FUNC(Escape)(const URI_CHAR * in, URI_CHAR * out,
 		UriBool spaceToPlus, UriBool normalizeBreaks) {
 	return URI_FUNC(EscapeEx)(in, NULL, out, spaceToPlus, normalizeBreaks);
@@ -75,8 +81,172 @@ URI_CHAR * URI_FUNC(Escape)(const URI_CHAR * in, URI_CHAR * out,
 
 
 
-URI_CHAR * URI_FUNC(EscapeEx)(const URI_CHAR * inFirst,
-		const URI_CHAR * inAfterLast, URI_CHAR * out,
+/* Number of characters EscapeEngine would write, excluding terminator */
+static size_t URI_FUNC(EscapedLengthEngine)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, UriEscapeMode mode,
+		UriBool spaceToPlus, UriBool normalizeBreaks) {
+	const URI_CHAR * read = inFirst;
+	size_t length = 0;
+	UriBool prevWasCr = URI_FALSE;
+
+	if (inFirst == NULL) {
+		return 0;
+	}
+
+	for (; (inAfterLast == NULL) || (read < inAfterLast); read++) {
+		if (URI_ESCAPE_IS_LITERAL(read[0], mode)) {
+			length++;
+			prevWasCr = URI_FALSE;
+			continue;
+		}
+
+		switch (URI_ESCAPE_CLASS(read[0])) {
+		case URI_ESCAPE_CLASS_TERMINATOR:
+			return length;
+
+		case URI_ESCAPE_CLASS_SPACE:
+			length += spaceToPlus ? 1 : 3;
+			prevWasCr = URI_FALSE;
+			break;
+
+		case URI_ESCAPE_CLASS_LF:
+			if (normalizeBreaks) {
+				length += prevWasCr ? 0 : 6;
+			} else {
+				length += 3;
+			}
+			prevWasCr = URI_FALSE;
+			break;
+
+		case URI_ESCAPE_CLASS_CR:
+			length += normalizeBreaks ? 6 : 3;
+			prevWasCr = URI_TRUE;
+			break;
+
+		default:
+			length += 3;
+			prevWasCr = URI_FALSE;
+			break;
+		}
+	}
+
+	return length;
+}
+
+
+
+/* Number of characters uriEscapeEx(A|W) would write, excluding terminator */
+size_t URI_FUNC(EscapedLength)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast,
+		UriBool spaceToPlus, UriBool normalizeBreaks) {
+	return URI_FUNC(EscapedLengthEngine)(inFirst, inAfterLast,
+			URI_ESCAPE_UNRESERVED, spaceToPlus, normalizeBreaks);
+}
+
+
+
+int URI_FUNC(EscapeCharsRequired)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, UriBool spaceToPlus,
+		UriBool normalizeBreaks, int * charsRequired) {
+	size_t length;
+
+	if ((inFirst == NULL) || (charsRequired == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if ((inAfterLast != NULL) && (inFirst > inAfterLast)) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	length = URI_FUNC(EscapedLength)(inFirst, inAfterLast, spaceToPlus,
+			normalizeBreaks);
+	if (length >= (size_t)INT_MAX) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	*charsRequired = (int)length;
+	return URI_SUCCESS;
+}
+
+
+
+/* Writes the encoding of a character that is not kept literally,
+ * i.e. up to six characters; a NUL character becomes "%00" */
+static URI_CHAR * URI_FUNC(EscapeChar)(URI_CHAR * write, URI_CHAR c,
+		UriBool spaceToPlus, UriBool normalizeBreaks, UriBool * prevWasCr) {
+	switch (URI_ESCAPE_CLASS(c)) {
+	case URI_ESCAPE_CLASS_SPACE:
+		if (spaceToPlus) {
+			write[0] = _UT('+');
+			write++;
+		} else {
+			write[0] = _UT('%');
+			write[1] = _UT('2');
+			write[2] = _UT('0');
+			write += 3;
+		}
+		*prevWasCr = URI_FALSE;
+		break;
+
+	case URI_ESCAPE_CLASS_LF:
+		if (normalizeBreaks) {
+			if (!*prevWasCr) {
+				write[0] = _UT('%');
+				write[1] = _UT('0');
+				write[2] = _UT('D');
+				write[3] = _UT('%');
+				write[4] = _UT('0');
+				write[5] = _UT('A');
+				write += 6;
+			}
+		} else {
+			write[0] = _UT('%');
+			write[1] = _UT('0');
+			write[2] = _UT('A');
+			write += 3;
+		}
+		*prevWasCr = URI_FALSE;
+		break;
+
+	case URI_ESCAPE_CLASS_CR:
+		if (normalizeBreaks) {
+			write[0] = _UT('%');
+			write[1] = _UT('0');
+			write[2] = _UT('D');
+			write[3] = _UT('%');
+			write[4] = _UT('0');
+			write[5] = _UT('A');
+			write += 6;
+		} else {
+			write[0] = _UT('%');
+			write[1] = _UT('0');
+			write[2] = _UT('D');
+			write += 3;
+		}
+		*prevWasCr = URI_TRUE;
+		break;
+
+	default:
+		/* Percent encode */
+		{
+			const unsigned char code = (unsigned char)c;
+			write[0] = _UT('%');
+			write[1] = URI_FUNC(HexToLetter)(code >> 4);
+			write[2] = URI_FUNC(HexToLetter)(code & 0x0f);
+			write += 3;
+		}
+		*prevWasCr = URI_FALSE;
+		break;
+	}
+
+	return write;
+}
+
+
+
+/* Percent-encodes all characters that mode does not allow literally */
+static URI_CHAR * URI_FUNC(EscapeEngine)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out, UriEscapeMode mode,
 		UriBool spaceToPlus, UriBool normalizeBreaks) {
 	const URI_CHAR * read = inFirst;
 	URI_CHAR * write = out;
@@ -91,361 +261,852 @@ URI_CHAR * URI_FUNC(EscapeEx)(const URI_CHAR * inFirst,
 	}
 
 	for (;;) {
+		/* Copy runs of literal characters in bulk */
+		const URI_CHAR * const runFirst = read;
+		while (((inAfterLast == NULL) || (read < inAfterLast))
+				&& URI_ESCAPE_IS_LITERAL(read[0], mode)) {
+			read++;
+		}
+		if (read > runFirst) {
+			memcpy(write, runFirst, (size_t)(read - runFirst) * sizeof(URI_CHAR));
+			write += read - runFirst;
+			prevWasCr = URI_FALSE;
+		}
+
 		if ((inAfterLast != NULL) && (read >= inAfterLast)) {
 			write[0] = _UT('\0');
 			return write;
 		}
 
-		switch (read[0]) {
-		case _UT('\0'):
+		if (URI_ESCAPE_CLASS(read[0]) == URI_ESCAPE_CLASS_TERMINATOR) {
 			write[0] = _UT('\0');
 			return write;
+		}
 
-		case _UT(' '):
-			if (spaceToPlus) {
-				write[0] = _UT('+');
+		write = URI_FUNC(EscapeChar)(write, read[0], spaceToPlus,
+				normalizeBreaks, &prevWasCr);
+		read++;
+	}
+}
+
+
+
+URI_CHAR * URI_FUNC(EscapeEx)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out,
+		UriBool spaceToPlus, UriBool normalizeBreaks) {
+	return URI_FUNC(EscapeEngine)(inFirst, inAfterLast, out,
+			URI_ESCAPE_UNRESERVED, spaceToPlus, normalizeBreaks);
+}
+
+
+
+/* Falls back to escaping everything but unreserved characters for
+ * unknown modes and only allows '+' for ' ' where '+' is escaped itself */
+static void URI_FUNC(EscapeComponentSanitize)(UriEscapeMode * mode,
+		UriBool * spaceToPlus) {
+	if (((unsigned int)*mode > (unsigned int)URI_ESCAPE_FRAGMENT)) {
+		*mode = URI_ESCAPE_UNRESERVED;
+	}
+	if ((*mode != URI_ESCAPE_UNRESERVED) && (*mode != URI_ESCAPE_QUERY_PARAM)) {
+		*spaceToPlus = URI_FALSE;
+	}
+}
+
+
+
+URI_CHAR * URI_FUNC(EscapeComponent)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out, UriEscapeMode mode,
+		UriBool spaceToPlus, UriBool normalizeBreaks) {
+	URI_FUNC(EscapeComponentSanitize)(&mode, &spaceToPlus);
+	return URI_FUNC(EscapeEngine)(inFirst, inAfterLast, out, mode,
+			spaceToPlus, normalizeBreaks);
+}
+
+
+
+int URI_FUNC(EscapeComponentCharsRequired)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, UriEscapeMode mode,
+		UriBool spaceToPlus, UriBool normalizeBreaks, int * charsRequired) {
+	size_t length;
+
+	if ((inFirst == NULL) || (charsRequired == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if ((inAfterLast != NULL) && (inFirst > inAfterLast)) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	URI_FUNC(EscapeComponentSanitize)(&mode, &spaceToPlus);
+	length = URI_FUNC(EscapedLengthEngine)(inFirst, inAfterLast, mode,
+			spaceToPlus, normalizeBreaks);
+	if (length >= (size_t)INT_MAX) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	*charsRequired = (int)length;
+	return URI_SUCCESS;
+}
+
+
+
+const URI_CHAR * URI_FUNC(UnescapeInPlace)(URI_CHAR * inout) {
+	return URI_FUNC(UnescapeInPlaceEx)(inout, URI_FALSE, URI_BR_DONT_TOUCH);
+}
+
+
+
+const URI_CHAR * URI_FUNC(UnescapeInPlaceEx)(URI_CHAR * inout,
+		UriBool plusToSpace, UriBreakConversion breakConversion) {
+	const URI_CHAR * afterLast;
+	URI_TYPE(TextRange) result;
+
+	if (inout == NULL) {
+		return NULL;
+	}
+
+	afterLast = inout + URI_STRLEN(inout);
+	URI_FUNC(UnescapeRangeEx)(inout, afterLast, inout, plusToSpace,
+			breakConversion, &result);
+	if (result.afterLast < afterLast) {
+		((URI_CHAR *)result.afterLast)[0] = _UT('\0');
+	}
+	return result.afterLast;
+}
+
+
+
+int URI_FUNC(UnescapeRange)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out,
+		URI_TYPE(TextRange) * result) {
+	return URI_FUNC(UnescapeRangeEx)(inFirst, inAfterLast, out, URI_FALSE,
+			URI_BR_DONT_TOUCH, result);
+}
+
+
+
+/* Finds the next character that unescaping would not just copy,
+ * i.e. the start of a percent group or '+' (with plusToSpace) */
+static const URI_CHAR * URI_FUNC(UnescapeFindSpecial)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, UriBool plusToSpace) {
+	for (;;) {
+		const URI_CHAR * candidate;
+
+		if (plusToSpace) {
+			candidate = first;
+			while ((candidate < afterLast) && (candidate[0] != _UT('%'))
+					&& (candidate[0] != _UT('+'))) {
+				candidate++;
+			}
+		} else {
+			/* Let libc do the scanning, it is likely vectorized */
+			candidate = (const URI_CHAR *)URI_MEMCHR(first, _UT('%'),
+					(size_t)(afterLast - first));
+			if (candidate == NULL) {
+				return afterLast;
+			}
+		}
+
+		if ((candidate >= afterLast)
+				|| (candidate[0] == _UT('+'))
+				|| ((afterLast - candidate >= 3)
+					&& URI_FUNC(IsHexdig)(candidate[1])
+					&& URI_FUNC(IsHexdig)(candidate[2]))) {
+			return candidate;
+		}
+
+		/* Incomplete percent group, copied as is */
+		first = candidate + 1;
+	}
+}
+
+
+
+/* Writes a decoded character (one or two characters
+ * with line break conversion) */
+static URI_CHAR * URI_FUNC(UnescapeCode)(URI_CHAR * write, int code,
+		UriBreakConversion breakConversion, UriBool * prevWasCr) {
+	switch (code) {
+	case 10:
+		switch (breakConversion) {
+		case URI_BR_TO_LF:
+			if (!*prevWasCr) {
+				write[0] = (URI_CHAR)10;
 				write++;
-			} else {
-				write[0] = _UT('%');
-				write[1] = _UT('2');
-				write[2] = _UT('0');
-				write += 3;
 			}
-			prevWasCr = URI_FALSE;
 			break;
 
-		case _UT('a'): /* ALPHA */
-		case _UT('A'):
-		case _UT('b'):
-		case _UT('B'):
-		case _UT('c'):
-		case _UT('C'):
-		case _UT('d'):
-		case _UT('D'):
-		case _UT('e'):
-		case _UT('E'):
-		case _UT('f'):
-		case _UT('F'):
-		case _UT('g'):
-		case _UT('G'):
-		case _UT('h'):
-		case _UT('H'):
-		case _UT('i'):
-		case _UT('I'):
-		case _UT('j'):
-		case _UT('J'):
-		case _UT('k'):
-		case _UT('K'):
-		case _UT('l'):
-		case _UT('L'):
-		case _UT('m'):
-		case _UT('M'):
-		case _UT('n'):
-		case _UT('N'):
-		case _UT('o'):
-		case _UT('O'):
-		case _UT('p'):
-		case _UT('P'):
-		case _UT('q'):
-		case _UT('Q'):
-		case _UT('r'):
-		case _UT('R'):
-		case _UT('s'):
-		case _UT('S'):
-		case _UT('t'):
-		case _UT('T'):
-		case _UT('u'):
-		case _UT('U'):
-		case _UT('v'):
-		case _UT('V'):
-		case _UT('w'):
-		case _UT('W'):
-		case _UT('x'):
-		case _UT('X'):
-		case _UT('y'):
-		case _UT('Y'):
-		case _UT('z'):
-		case _UT('Z'):
-		case _UT('0'): /* DIGIT */
-		case _UT('1'):
-		case _UT('2'):
-		case _UT('3'):
-		case _UT('4'):
-		case _UT('5'):
-		case _UT('6'):
-		case _UT('7'):
-		case _UT('8'):
-		case _UT('9'):
-		case _UT('-'): /* "-" / "." / "_" / "~" */
-		case _UT('.'):
-		case _UT('_'):
-		case _UT('~'):
-			/* Copy unmodified */
-			write[0] = read[0];
+		case URI_BR_TO_CRLF:
+			if (!*prevWasCr) {
+				write[0] = (URI_CHAR)13;
+				write[1] = (URI_CHAR)10;
+				write += 2;
+			}
+			break;
+
+		case URI_BR_TO_CR:
+			if (!*prevWasCr) {
+				write[0] = (URI_CHAR)13;
+				write++;
+			}
+			break;
+
+		case URI_BR_DONT_TOUCH:
+		default:
+			write[0] = (URI_CHAR)10;
 			write++;
 
-			prevWasCr = URI_FALSE;
+		}
+		*prevWasCr = URI_FALSE;
+		break;
+
+	case 13:
+		switch (breakConversion) {
+		case URI_BR_TO_LF:
+			write[0] = (URI_CHAR)10;
+			write++;
 			break;
 
-		case _UT('\x0a'):
-			if (normalizeBreaks) {
-				if (!prevWasCr) {
-					write[0] = _UT('%');
-					write[1] = _UT('0');
-					write[2] = _UT('D');
-					write[3] = _UT('%');
-					write[4] = _UT('0');
-					write[5] = _UT('A');
-					write += 6;
-				}
-			} else {
-				write[0] = _UT('%');
-				write[1] = _UT('0');
-				write[2] = _UT('A');
-				write += 3;
-			}
-			prevWasCr = URI_FALSE;
+		case URI_BR_TO_CRLF:
+			write[0] = (URI_CHAR)13;
+			write[1] = (URI_CHAR)10;
+			write += 2;
 			break;
 
-		case _UT('\x0d'):
-			if (normalizeBreaks) {
-				write[0] = _UT('%');
-				write[1] = _UT('0');
-				write[2] = _UT('D');
-				write[3] = _UT('%');
-				write[4] = _UT('0');
-				write[5] = _UT('A');
-				write += 6;
-			} else {
-				write[0] = _UT('%');
-				write[1] = _UT('0');
-				write[2] = _UT('D');
-				write += 3;
-			}
-			prevWasCr = URI_TRUE;
+		case URI_BR_TO_CR:
+			write[0] = (URI_CHAR)13;
+			write++;
 			break;
 
+		case URI_BR_DONT_TOUCH:
 		default:
-			/* Percent encode */
-			{
-				const unsigned char code = (unsigned char)read[0];
-				write[0] = _UT('%');
-				write[1] = URI_FUNC(HexToLetter)(code >> 4);
-				write[2] = URI_FUNC(HexToLetter)(code & 0x0f);
-				write += 3;
+			write[0] = (URI_CHAR)13;
+			write++;
+
+		}
+		*prevWasCr = URI_TRUE;
+		break;
+
+	default:
+		write[0] = (URI_CHAR)(code);
+		write++;
+
+		*prevWasCr = URI_FALSE;
+
+	}
+
+	return write;
+}
+
+
+
+int URI_FUNC(UnescapeRangeEx)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		URI_TYPE(TextRange) * result) {
+	const URI_CHAR * read = inFirst;
+	const URI_CHAR * special;
+	URI_CHAR * write = out;
+	UriBool prevWasCr = URI_FALSE;
+
+	if ((inFirst == NULL) || (inAfterLast == NULL) || (out == NULL)
+			|| (result == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (inFirst > inAfterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	special = URI_FUNC(UnescapeFindSpecial)(inFirst, inAfterLast, plusToSpace);
+	if (special == inAfterLast) {
+		/* Nothing to decode, leave out untouched */
+		result->first = inFirst;
+		result->afterLast = inAfterLast;
+		return URI_SUCCESS;
+	}
+
+	for (;;) {
+		/* Move the clean run before in bulk */
+		if (special > read) {
+			const size_t runLen = (size_t)(special - read);
+			if (write != read) {
+				memmove(write, read, runLen * sizeof(URI_CHAR));
 			}
+			write += runLen;
+			read = special;
 			prevWasCr = URI_FALSE;
+		}
+
+		if (read >= inAfterLast) {
 			break;
 		}
 
-		read++;
+		if (read[0] == _UT('+')) {
+			/* Convert '+' to ' ' */
+			write[0] = _UT(' ');
+			write++;
+			read++;
+			prevWasCr = URI_FALSE;
+		} else {
+			/* Percent group found */
+			const unsigned char left = URI_FUNC(HexdigToInt)(read[1]);
+			const unsigned char right = URI_FUNC(HexdigToInt)(read[2]);
+			const int code = 16 * left + right;
+			write = URI_FUNC(UnescapeCode)(write, code, breakConversion,
+					&prevWasCr);
+			read += 3;
+		}
+
+		special = URI_FUNC(UnescapeFindSpecial)(read, inAfterLast, plusToSpace);
 	}
+
+	result->first = out;
+	result->afterLast = write;
+	return URI_SUCCESS;
 }
 
 
 
-const URI_CHAR * URI_FUNC(UnescapeInPlace)(URI_CHAR * inout) {
-	return URI_FUNC(UnescapeInPlaceEx)(inout, URI_FALSE, URI_BR_DONT_TOUCH);
+#ifdef URI_PASS_ANSI
+/* Finds the end of a run of ASCII characters other than '%' (and '+'
+ * with plusToSpace), looking at a machine word at a time while possible */
+static const URI_CHAR * URI_FUNC(Utf8CleanRunEnd)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, UriBool plusToSpace) {
+	const size_t ones = ((size_t)-1) / 0xff;
+	const size_t highs = ones * 0x80;
+	const size_t percents = ones * (unsigned char)'%';
+	const size_t pluses = plusToSpace ? ones * (unsigned char)'+' : 0;
+
+	while ((size_t)(afterLast - first) >= sizeof(size_t)) {
+		size_t word;
+		size_t percentZeros;
+		size_t plusZeros;
+
+		memcpy(&word, first, sizeof(size_t));
+		percentZeros = word ^ percents;
+		percentZeros = (percentZeros - ones) & ~percentZeros;
+		if (plusToSpace) {
+			plusZeros = word ^ pluses;
+			plusZeros = (plusZeros - ones) & ~plusZeros;
+		} else {
+			plusZeros = 0;
+		}
+		if (((word | percentZeros | plusZeros) & highs) != 0) {
+			break;
+		}
+		first += sizeof(size_t);
+	}
+
+	while (first < afterLast) {
+		const unsigned char code = (unsigned char)first[0];
+		if ((code >= 0x80) || (code == '%') || (plusToSpace && (code == '+'))) {
+			break;
+		}
+		first++;
+	}
+
+	return first;
 }
 
 
 
-const URI_CHAR * URI_FUNC(UnescapeInPlaceEx)(URI_CHAR * inout,
-		UriBool plusToSpace, UriBreakConversion breakConversion) {
-	URI_CHAR * read = inout;
-	URI_CHAR * write = inout;
+/* Deals with an invalid sequence starting at seqIn and seqOut,
+ * either failing or writing U+FFFD over its output */
+static int URI_FUNC(Utf8Invalid)(const URI_CHAR * seqIn,
+		URI_CHAR * seqOut, URI_CHAR ** write, UriBool replaceInvalid,
+		const URI_CHAR ** errorPos) {
+	if ((errorPos != NULL) && (*errorPos == NULL)) {
+		*errorPos = seqIn;
+	}
+
+	if (!replaceInvalid) {
+		return URI_ERROR_SYNTAX;
+	}
+
+	seqOut[0] = (URI_CHAR)0xef;
+	seqOut[1] = (URI_CHAR)0xbf;
+	seqOut[2] = (URI_CHAR)0xbd;
+	*write = seqOut + 3;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(UnescapeRangeUtf8)(const URI_CHAR * inFirst,
+		const URI_CHAR * inAfterLast, URI_CHAR * out,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriBool replaceInvalid, URI_TYPE(TextRange) * result,
+		const URI_CHAR ** errorPos) {
+	const URI_CHAR * read = inFirst;
+	URI_CHAR * write = out;
+	const URI_CHAR * seqIn = NULL;
+	URI_CHAR * seqOut = NULL;
+	int need = 0; /* Continuation bytes still expected */
+	unsigned char lower = 0x80; /* Range of the next continuation byte */
+	unsigned char upper = 0xbf;
 	UriBool prevWasCr = URI_FALSE;
+	int res;
 
-	if (inout == NULL) {
-		return NULL;
+	if ((inFirst == NULL) || (inAfterLast == NULL) || (out == NULL)
+			|| (result == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	/* Replacements can outgrow the input and overrun unread text */
+	if ((inFirst > inAfterLast) || (replaceInvalid && (out == inFirst))) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	if (errorPos != NULL) {
+		*errorPos = NULL;
+	}
+
+	if (URI_FUNC(Utf8CleanRunEnd)(inFirst, inAfterLast, plusToSpace)
+			== inAfterLast) {
+		/* Plain ASCII, nothing to decode, leave out untouched */
+		result->first = inFirst;
+		result->afterLast = inAfterLast;
+		return URI_SUCCESS;
 	}
 
 	for (;;) {
-		switch (read[0]) {
-		case _UT('\0'):
-			if (read > write) {
-				write[0] = _UT('\0');
-			}
-			return write;
+		const URI_CHAR * const unitFirst = read;
+		unsigned char code;
+		UriBool decoded = URI_FALSE;
 
-		case _UT('%'):
-			switch (read[1]) {
-			case _UT('0'):
-			case _UT('1'):
-			case _UT('2'):
-			case _UT('3'):
-			case _UT('4'):
-			case _UT('5'):
-			case _UT('6'):
-			case _UT('7'):
-			case _UT('8'):
-			case _UT('9'):
-			case _UT('a'):
-			case _UT('b'):
-			case _UT('c'):
-			case _UT('d'):
-			case _UT('e'):
-			case _UT('f'):
-			case _UT('A'):
-			case _UT('B'):
-			case _UT('C'):
-			case _UT('D'):
-			case _UT('E'):
-			case _UT('F'):
-				switch (read[2]) {
-				case _UT('0'):
-				case _UT('1'):
-				case _UT('2'):
-				case _UT('3'):
-				case _UT('4'):
-				case _UT('5'):
-				case _UT('6'):
-				case _UT('7'):
-				case _UT('8'):
-				case _UT('9'):
-				case _UT('a'):
-				case _UT('b'):
-				case _UT('c'):
-				case _UT('d'):
-				case _UT('e'):
-				case _UT('f'):
-				case _UT('A'):
-				case _UT('B'):
-				case _UT('C'):
-				case _UT('D'):
-				case _UT('E'):
-				case _UT('F'):
-					{
-						/* Percent group found */
-						const unsigned char left = URI_FUNC(HexdigToInt)(read[1]);
-						const unsigned char right = URI_FUNC(HexdigToInt)(read[2]);
-						const int code = 16 * left + right;
-						switch (code) {
-						case 10:
-							switch (breakConversion) {
-							case URI_BR_TO_LF:
-								if (!prevWasCr) {
-									write[0] = (URI_CHAR)10;
-									write++;
-								}
-								break;
-
-							case URI_BR_TO_CRLF:
-								if (!prevWasCr) {
-									write[0] = (URI_CHAR)13;
-									write[1] = (URI_CHAR)10;
-									write += 2;
-								}
-								break;
-
-							case URI_BR_TO_CR:
-								if (!prevWasCr) {
-									write[0] = (URI_CHAR)13;
-									write++;
-								}
-								break;
-
-							case URI_BR_DONT_TOUCH:
-							default:
-								write[0] = (URI_CHAR)10;
-								write++;
-
-							}
-							prevWasCr = URI_FALSE;
-							break;
-
-						case 13:
-							switch (breakConversion) {
-							case URI_BR_TO_LF:
-								write[0] = (URI_CHAR)10;
-								write++;
-								break;
-
-							case URI_BR_TO_CRLF:
-								write[0] = (URI_CHAR)13;
-								write[1] = (URI_CHAR)10;
-								write += 2;
-								break;
-
-							case URI_BR_TO_CR:
-								write[0] = (URI_CHAR)13;
-								write++;
-								break;
-
-							case URI_BR_DONT_TOUCH:
-							default:
-								write[0] = (URI_CHAR)13;
-								write++;
-
-							}
-							prevWasCr = URI_TRUE;
-							break;
-
-						default:
-							write[0] = (URI_CHAR)(code);
-							write++;
-
-							prevWasCr = URI_FALSE;
-
-						}
-						read += 3;
-					}
-					break;
-
-				default:
-					/* Copy two chars unmodified and */
-					/* look at this char again */
-					if (read > write) {
-						write[0] = read[0];
-						write[1] = read[1];
-					}
-					read += 2;
-					write += 2;
-
-					prevWasCr = URI_FALSE;
+		/* Move clean runs between sequences in bulk */
+		if (need == 0) {
+			const URI_CHAR * const runEnd = URI_FUNC(Utf8CleanRunEnd)(read,
+					inAfterLast, plusToSpace);
+			if (runEnd > read) {
+				const size_t runLen = (size_t)(runEnd - read);
+				if (write != read) {
+					memmove(write, read, runLen * sizeof(URI_CHAR));
 				}
-				break;
+				write += runLen;
+				read = runEnd;
+				prevWasCr = URI_FALSE;
+				continue;
+			}
+		}
 
-			default:
-				/* Copy one char unmodified and */
-				/* look at this char again */
-				if (read > write) {
-					write[0] = read[0];
-				}
-				read++;
+		if (read >= inAfterLast) {
+			break;
+		}
+
+		if ((read[0] == _UT('%')) && (inAfterLast - read >= 3)
+				&& URI_FUNC(IsHexdig)(read[1])
+				&& URI_FUNC(IsHexdig)(read[2])) {
+			code = (unsigned char)(16 * URI_FUNC(HexdigToInt)(read[1])
+					+ URI_FUNC(HexdigToInt)(read[2]));
+			decoded = URI_TRUE;
+			read += 3;
+		} else if (plusToSpace && (read[0] == _UT('+'))) {
+			code = ' ';
+			read++;
+		} else {
+			code = (unsigned char)read[0];
+			read++;
+		}
+
+		if (need > 0) {
+			if ((code >= lower) && (code <= upper)) {
+				write[0] = (URI_CHAR)code;
 				write++;
+				need--;
+				lower = 0x80;
+				upper = 0xbf;
+				continue;
+			}
 
+			/* Sequence cut short, code starts over */
+			res = URI_FUNC(Utf8Invalid)(seqIn, seqOut, &write,
+					replaceInvalid, errorPos);
+			if (res != URI_SUCCESS) {
+				return res;
+			}
+			need = 0;
+			lower = 0x80;
+			upper = 0xbf;
+		}
+
+		if (code < 0x80) {
+			if (decoded) {
+				write = URI_FUNC(UnescapeCode)(write, code, breakConversion,
+						&prevWasCr);
+			} else {
+				write[0] = (URI_CHAR)code;
+				write++;
 				prevWasCr = URI_FALSE;
 			}
+			continue;
+		}
+
+		prevWasCr = URI_FALSE;
+		seqIn = unitFirst;
+		seqOut = write;
+
+		if ((code < 0xc2) || (code > 0xf4)) {
+			/* Continuation byte without lead byte or never valid */
+			res = URI_FUNC(Utf8Invalid)(seqIn, seqOut, &write,
+					replaceInvalid, errorPos);
+			if (res != URI_SUCCESS) {
+				return res;
+			}
+			continue;
+		}
+
+		write[0] = (URI_CHAR)code;
+		write++;
+		need = (code < 0xe0) ? 1 : (code < 0xf0) ? 2 : 3;
+		if (code == 0xe0) {
+			lower = 0xa0; /* No overlong forms */
+		} else if (code == 0xed) {
+			upper = 0x9f; /* No surrogates */
+		} else if (code == 0xf0) {
+			lower = 0x90; /* No overlong forms */
+		} else if (code == 0xf4) {
+			upper = 0x8f; /* Nothing above U+10FFFF */
+		}
+	}
+
+	if (need > 0) {
+		/* Truncated at the end */
+		res = URI_FUNC(Utf8Invalid)(seqIn, seqOut, &write, replaceInvalid,
+				errorPos);
+		if (res != URI_SUCCESS) {
+			return res;
+		}
+	}
+
+	result->first = out;
+	result->afterLast = write;
+	return URI_SUCCESS;
+}
+#endif /* URI_PASS_ANSI */
+
+
+
+/* Appends text to the window of a stream, passing the window
+ * to the sink whenever it is full; text at least a window long
+ * goes to the sink directly while the window is empty */
+static int URI_FUNC(StreamWrite)(URI_CHAR * window, size_t windowChars,
+		size_t * fill, URI_TYPE(TextSink) sink, void * userData,
+		const URI_CHAR * text, size_t count) {
+	while (count > 0) {
+		size_t space = windowChars - *fill;
+
+		if ((*fill == 0) && (count >= windowChars)) {
+			return sink(userData, text, text + count);
+		}
+
+		if (space == 0) {
+			const int res = sink(userData, window, window + windowChars);
+			if (res != URI_SUCCESS) {
+				return res;
+			}
+			*fill = 0;
+			continue;
+		}
+
+		if (space > count) {
+			space = count;
+		}
+		memcpy(window + *fill, text, space * sizeof(URI_CHAR));
+		*fill += space;
+		text += space;
+		count -= space;
+	}
+
+	return URI_SUCCESS;
+}
+
+
+
+/* Passes what is left in the window of a stream to the sink */
+static int URI_FUNC(StreamFlush)(URI_CHAR * window, size_t * fill,
+		URI_TYPE(TextSink) sink, void * userData) {
+	const size_t count = *fill;
+
+	if (count == 0) {
+		return URI_SUCCESS;
+	}
+
+	*fill = 0;
+	return sink(userData, window, window + count);
+}
+
+
+
+int URI_FUNC(EscapeStreamInit)(URI_TYPE(EscapeStream) * stream,
+		URI_CHAR * window, int windowChars, URI_TYPE(TextSink) sink,
+		void * userData, UriEscapeMode mode, UriBool spaceToPlus,
+		UriBool normalizeBreaks) {
+	if ((stream == NULL) || (window == NULL) || (sink == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (windowChars < 1) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	URI_FUNC(EscapeComponentSanitize)(&mode, &spaceToPlus);
+
+	stream->window = window;
+	stream->windowChars = (size_t)windowChars;
+	stream->fill = 0;
+	stream->sink = sink;
+	stream->userData = userData;
+	stream->mode = mode;
+	stream->spaceToPlus = spaceToPlus;
+	stream->normalizeBreaks = normalizeBreaks;
+	stream->prevWasCr = URI_FALSE;
+	stream->error = URI_SUCCESS;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(EscapeStreamFeed)(URI_TYPE(EscapeStream) * stream,
+		const URI_CHAR * first, const URI_CHAR * afterLast) {
+	const URI_CHAR * read = first;
+
+	if (stream == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	if (stream->error != URI_SUCCESS) {
+		return stream->error;
+	}
+
+	if ((first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	while (read < afterLast) {
+		/* Pass runs of literal characters in bulk */
+		const URI_CHAR * const runFirst = read;
+		URI_CHAR encoded[6];
+		const URI_CHAR * encodedAfterLast;
+		int res;
+
+		while ((read < afterLast)
+				&& URI_ESCAPE_IS_LITERAL(read[0], stream->mode)) {
+			read++;
+		}
+		if (read > runFirst) {
+			res = URI_FUNC(StreamWrite)(stream->window, stream->windowChars,
+					&stream->fill, stream->sink, stream->userData,
+					runFirst, (size_t)(read - runFirst));
+			if (res != URI_SUCCESS) {
+				stream->error = res;
+				return res;
+			}
+			stream->prevWasCr = URI_FALSE;
+		}
+
+		if (read >= afterLast) {
 			break;
+		}
 
-		case _UT('+'):
-			if (plusToSpace) {
-				/* Convert '+' to ' ' */
-				write[0] = _UT(' ');
-			} else {
-				/* Copy one char unmodified */
-				if (read > write) {
-					write[0] = read[0];
+		encodedAfterLast = URI_FUNC(EscapeChar)(encoded, read[0],
+				stream->spaceToPlus, stream->normalizeBreaks,
+				&stream->prevWasCr);
+		res = URI_FUNC(StreamWrite)(stream->window, stream->windowChars,
+				&stream->fill, stream->sink, stream->userData,
+				encoded, (size_t)(encodedAfterLast - encoded));
+		if (res != URI_SUCCESS) {
+			stream->error = res;
+			return res;
+		}
+		read++;
+	}
+
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(EscapeStreamFinish)(URI_TYPE(EscapeStream) * stream) {
+	if (stream == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	if (stream->error == URI_SUCCESS) {
+		stream->error = URI_FUNC(StreamFlush)(stream->window, &stream->fill,
+				stream->sink, stream->userData);
+	}
+	return stream->error;
+}
+
+
+
+int URI_FUNC(UnescapeStreamInit)(URI_TYPE(UnescapeStream) * stream,
+		URI_CHAR * window, int windowChars, URI_TYPE(TextSink) sink,
+		void * userData, UriBool plusToSpace,
+		UriBreakConversion breakConversion) {
+	if ((stream == NULL) || (window == NULL) || (sink == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (windowChars < 1) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	stream->window = window;
+	stream->windowChars = (size_t)windowChars;
+	stream->fill = 0;
+	stream->sink = sink;
+	stream->userData = userData;
+	stream->plusToSpace = plusToSpace;
+	stream->breakConversion = breakConversion;
+	stream->prevWasCr = URI_FALSE;
+	stream->pendingCount = 0;
+	stream->error = URI_SUCCESS;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(UnescapeStreamFeed)(URI_TYPE(UnescapeStream) * stream,
+		const URI_CHAR * first, const URI_CHAR * afterLast) {
+	const URI_CHAR * read = first;
+
+	if (stream == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	if (stream->error != URI_SUCCESS) {
+		return stream->error;
+	}
+
+	if ((first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	while (read < afterLast) {
+		URI_CHAR decoded[2];
+		const URI_CHAR * decodedAfterLast;
+		const URI_CHAR * special;
+		int res;
+
+		if (stream->pendingCount > 0) {
+			/* Continue a percent group started earlier */
+			if (!URI_FUNC(IsHexdig)(read[0])) {
+				/* Incomplete percent group, passed on as is */
+				res = URI_FUNC(StreamWrite)(stream->window,
+						stream->windowChars, &stream->fill, stream->sink,
+						stream->userData, stream->pending,
+						(size_t)stream->pendingCount);
+				if (res != URI_SUCCESS) {
+					stream->error = res;
+					return res;
 				}
+				stream->pendingCount = 0;
+				stream->prevWasCr = URI_FALSE;
+				continue;
+			}
+
+			if (stream->pendingCount == 1) {
+				stream->pending[1] = read[0];
+				stream->pendingCount = 2;
+				read++;
+				continue;
 			}
+
+			decodedAfterLast = URI_FUNC(UnescapeCode)(decoded,
+					16 * URI_FUNC(HexdigToInt)(stream->pending[1])
+						+ URI_FUNC(HexdigToInt)(read[0]),
+					stream->breakConversion, &stream->prevWasCr);
+			stream->pendingCount = 0;
 			read++;
-			write++;
+		} else {
+			/* Pass runs without '%' (or '+') in bulk */
+			if (stream->plusToSpace) {
+				special = read;
+				while ((special < afterLast) && (special[0] != _UT('%'))
+						&& (special[0] != _UT('+'))) {
+					special++;
+				}
+			} else {
+				special = (const URI_CHAR *)URI_MEMCHR(read, _UT('%'),
+						(size_t)(afterLast - read));
+				if (special == NULL) {
+					special = afterLast;
+				}
+			}
 
-			prevWasCr = URI_FALSE;
-			break;
+			if (special > read) {
+				res = URI_FUNC(StreamWrite)(stream->window,
+						stream->windowChars, &stream->fill, stream->sink,
+						stream->userData, read, (size_t)(special - read));
+				if (res != URI_SUCCESS) {
+					stream->error = res;
+					return res;
+				}
+				stream->prevWasCr = URI_FALSE;
+				read = special;
+			}
 
-		default:
-			/* Copy one char unmodified */
-			if (read > write) {
-				write[0] = read[0];
+			if (read >= afterLast) {
+				break;
+			}
+
+			if (read[0] == _UT('%')) {
+				stream->pending[0] = _UT('%');
+				stream->pendingCount = 1;
+				read++;
+				continue;
 			}
+
+			/* Convert '+' to ' ' */
+			decoded[0] = _UT(' ');
+			decodedAfterLast = decoded + 1;
+			stream->prevWasCr = URI_FALSE;
 			read++;
-			write++;
+		}
 
-			prevWasCr = URI_FALSE;
+		res = URI_FUNC(StreamWrite)(stream->window, stream->windowChars,
+				&stream->fill, stream->sink, stream->userData,
+				decoded, (size_t)(decodedAfterLast - decoded));
+		if (res != URI_SUCCESS) {
+			stream->error = res;
+			return res;
 		}
 	}
+
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(UnescapeStreamFinish)(URI_TYPE(UnescapeStream) * stream) {
+	if (stream == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	if ((stream->error == URI_SUCCESS) && (stream->pendingCount > 0)) {
+		stream->error = URI_FUNC(StreamWrite)(stream->window,
+				stream->windowChars, &stream->fill, stream->sink,
+				stream->userData, stream->pending,
+				(size_t)stream->pendingCount);
+		stream->pendingCount = 0;
+	}
+
+	if (stream->error == URI_SUCCESS) {
+		stream->error = URI_FUNC(StreamFlush)(stream->window, &stream->fill,
+				stream->sink, stream->userData);
+	}
+	return stream->error;
 }
 
 
@@ -0,0 +1,131 @@
+/*
+ * uriparser - RFC 3986 URI parsing library
+ *
+ * Copyright (C) 2025, Sebastian Pipping <sebastian@pipping.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source  and binary forms, with or without
+ * modification, are permitted provided  that the following conditions
+ * are met:
+ *
+ *     1. Redistributions  of  source  code   must  retain  the  above
+ *        copyright notice, this list  of conditions and the following
+ *        disclaimer.
+ *
+ *     2. Redistributions  in binary  form  must  reproduce the  above
+ *        copyright notice, this list  of conditions and the following
+ *        disclaimer  in  the  documentation  and/or  other  materials
+ *        provided with the distribution.
+ *
+ *     3. Neither the  name of the  copyright holder nor the  names of
+ *        its contributors may be used  to endorse or promote products
+ *        derived from  this software  without specific  prior written
+ *        permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND  ANY EXPRESS OR IMPLIED WARRANTIES,  INCLUDING, BUT NOT
+ * LIMITED TO,  THE IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS
+ * FOR  A  PARTICULAR  PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL
+ * THE  COPYRIGHT HOLDER  OR CONTRIBUTORS  BE LIABLE  FOR ANY  DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA,  OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT  LIABILITY,  OR  TORT (INCLUDING  NEGLIGENCE  OR  OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_DOXYGEN
+# include "UriEscapeBase.h"
+#endif
+
+
+
+#define U  URI_ESCAPE_CLASS_UNRESERVED
+#define O  URI_ESCAPE_CLASS_OTHER
+#define S  URI_ESCAPE_CLASS_SPACE
+#define L  URI_ESCAPE_CLASS_LF
+#define C  URI_ESCAPE_CLASS_CR
+#define T  URI_ESCAPE_CLASS_TERMINATOR
+
+const unsigned char uriEscapeClasses[256] = {
+	T, O, O, O, O, O, O, O, O, O, L, O, O, C, O, O, /* 0x00 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0x10 */
+	S, O, O, O, O, O, O, O, O, O, O, O, O, U, U, O, /* 0x20 */
+	U, U, U, U, U, U, U, U, U, U, O, O, O, O, O, O, /* 0x30 */
+	O, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 0x40 */
+	U, U, U, U, U, U, U, U, U, U, U, O, O, O, O, U, /* 0x50 */
+	O, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 0x60 */
+	U, U, U, U, U, U, U, U, U, U, U, O, O, O, U, O, /* 0x70 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0x80 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0x90 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xA0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xB0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xC0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xD0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xE0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O  /* 0xF0 */
+};
+
+#undef U
+#undef O
+#undef S
+#undef L
+#undef C
+#undef T
+
+
+
+#define M(mode)  (1u << (mode))
+
+/* Unreserved characters */
+#define U  (M(URI_ESCAPE_UNRESERVED) | M(URI_ESCAPE_USER_INFO) \
+		| M(URI_ESCAPE_PATH_SEGMENT) | M(URI_ESCAPE_PATH) | M(URI_ESCAPE_QUERY) \
+		| M(URI_ESCAPE_QUERY_PARAM) | M(URI_ESCAPE_FRAGMENT))
+/* Sub-delims other than '&', '=' and '+', and ':' */
+#define D  (M(URI_ESCAPE_USER_INFO) | M(URI_ESCAPE_PATH_SEGMENT) \
+		| M(URI_ESCAPE_PATH) | M(URI_ESCAPE_QUERY) | M(URI_ESCAPE_QUERY_PARAM) \
+		| M(URI_ESCAPE_FRAGMENT))
+/* '&', '=' and '+' */
+#define P  (M(URI_ESCAPE_USER_INFO) | M(URI_ESCAPE_PATH_SEGMENT) \
+		| M(URI_ESCAPE_PATH) | M(URI_ESCAPE_QUERY) | M(URI_ESCAPE_FRAGMENT))
+/* '@' */
+#define A  (M(URI_ESCAPE_PATH_SEGMENT) | M(URI_ESCAPE_PATH) \
+		| M(URI_ESCAPE_QUERY) | M(URI_ESCAPE_QUERY_PARAM) | M(URI_ESCAPE_FRAGMENT))
+/* '/' */
+#define S  (M(URI_ESCAPE_PATH) | M(URI_ESCAPE_QUERY) \
+		| M(URI_ESCAPE_QUERY_PARAM) | M(URI_ESCAPE_FRAGMENT))
+/* '?' */
+#define Q  (M(URI_ESCAPE_QUERY) | M(URI_ESCAPE_QUERY_PARAM) \
+		| M(URI_ESCAPE_FRAGMENT))
+/* Never kept */
+#define O  0
+
+const unsigned char uriEscapeLiteralModes[256] = {
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0x00 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0x10 */
+	O, D, O, O, D, O, P, D, D, D, D, P, D, U, U, S, /* 0x20 */
+	U, U, U, U, U, U, U, U, U, U, D, D, O, P, O, Q, /* 0x30 */
+	A, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 0x40 */
+	U, U, U, U, U, U, U, U, U, U, U, O, O, O, O, U, /* 0x50 */
+	O, U, U, U, U, U, U, U, U, U, U, U, U, U, U, U, /* 0x60 */
+	U, U, U, U, U, U, U, U, U, U, U, O, O, O, U, O, /* 0x70 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0x80 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0x90 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xA0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xB0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xC0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xD0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, /* 0xE0 */
+	O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O  /* 0xF0 */
+};
+
+#undef M
+#undef U
+#undef D
+#undef P
+#undef A
+#undef S
+#undef Q
+#undef O
@@ -0,0 +1,75 @@
+/*
+ * uriparser - RFC 3986 URI parsing library
+ *
+ * Copyright (C) 2025, Sebastian Pipping <sebastian@pipping.org>
+ * All rights reserved.
+ *
+ * Redistribution and use in source  and binary forms, with or without
+ * modification, are permitted provided  that the following conditions
+ * are met:
+ *
+ *     1. Redistributions  of  source  code   must  retain  the  above
+ *        copyright notice, this list  of conditions and the following
+ *        disclaimer.
+ *
+ *     2. Redistributions  in binary  form  must  reproduce the  above
+ *        copyright notice, this list  of conditions and the following
+ *        disclaimer  in  the  documentation  and/or  other  materials
+ *        provided with the distribution.
+ *
+ *     3. Neither the  name of the  copyright holder nor the  names of
+ *        its contributors may be used  to endorse or promote products
+ *        derived from  this software  without specific  prior written
+ *        permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND  ANY EXPRESS OR IMPLIED WARRANTIES,  INCLUDING, BUT NOT
+ * LIMITED TO,  THE IMPLIED WARRANTIES OF  MERCHANTABILITY AND FITNESS
+ * FOR  A  PARTICULAR  PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL
+ * THE  COPYRIGHT HOLDER  OR CONTRIBUTORS  BE LIABLE  FOR ANY  DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL,  EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO,  PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA,  OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT  LIABILITY,  OR  TORT (INCLUDING  NEGLIGENCE  OR  OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED
+ * OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URI_ESCAPE_BASE_H
+#define URI_ESCAPE_BASE_H 1
+
+
+
+#include <uriparser/UriBase.h>
+
+
+
+/* How uriEscapeEx(A|W) treats a character */
+#define URI_ESCAPE_CLASS_UNRESERVED  0 /* Copied unmodified */
+#define URI_ESCAPE_CLASS_OTHER       1 /* Percent-encoded */
+#define URI_ESCAPE_CLASS_SPACE       2 /* '+' or "%20" */
+#define URI_ESCAPE_CLASS_LF          3 /* "%0A" or part of "%0D%0A" */
+#define URI_ESCAPE_CLASS_CR          4 /* "%0D" or "%0D%0A" */
+#define URI_ESCAPE_CLASS_TERMINATOR  5 /* Ends input */
+
+extern const unsigned char uriEscapeClasses[256];
+
+#define URI_ESCAPE_CLASS(code) \
+		(((unsigned int)(code) < 256) \
+			? uriEscapeClasses[(unsigned int)(code)] \
+			: URI_ESCAPE_CLASS_OTHER)
+
+
+
+/* Bit (1 << mode) is set for each UriEscapeMode keeping a character as-is */
+extern const unsigned char uriEscapeLiteralModes[256];
+
+#define URI_ESCAPE_IS_LITERAL(code, mode) \
+		(((unsigned int)(code) < 256) \
+			&& ((uriEscapeLiteralModes[(unsigned int)(code)] \
+				& (1u << (unsigned int)(mode))) != 0))
+
+
+
+#endif /* URI_ESCAPE_BASE_H */
@@ -56,6 +56,20 @@
 #include <errno.h>
 #include <stdlib.h>
 
+/* Atomic operations for reference counting of frozen URIs */
+#if defined(__GNUC__) && defined(__ATOMIC_RELAXED)
+# define URI_ATOMIC_GNUC 1
+#elif defined(_MSC_VER)
+# include <intrin.h>
+# define URI_ATOMIC_MSVC 1
+#elif defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) \
+		&& !defined(__STDC_NO_ATOMICS__)
+# include <stdatomic.h>
+# define URI_ATOMIC_C11 1
+#else
+# error "No atomic operations available, uriFreezeUriMmA needs them"
+#endif
+
 
 
 #ifndef URI_DOXYGEN
@@ -288,6 +302,538 @@ int uriCompleteMemoryManager(UriMemoryManager * memory,
 
 
 
+/* Header in front of sized allocations that are released through memory->free */
+typedef struct UriSizedHeaderStruct {
+	size_t size;
+	size_t kind;
+} UriSizedHeader;
+
+
+
+static void * uriSizedMallocKind(UriMemoryManager * memory,
+		size_t size, UriMemoryKind kind) {
+	UriSizedMemoryBackend * backend;
+	const size_t extraBytes = sizeof(UriSizedHeader);
+	UriSizedHeader * header;
+
+	if (memory == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	/* check for unsigned overflow */
+	if (size > ((size_t)-1) - extraBytes) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	backend = (UriSizedMemoryBackend *)memory->userData;
+	if (backend == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	header = backend->malloc(backend, extraBytes + size, kind);
+	if (header == NULL) {
+		return NULL;
+	}
+
+	header->size = size;
+	header->kind = (size_t)kind;
+
+	return (char *)header + extraBytes;
+}
+
+
+
+static void * uriSizedMalloc(UriMemoryManager * memory, size_t size) {
+	return uriSizedMallocKind(memory, size, URI_MEMORY_UNKNOWN);
+}
+
+
+
+static void * uriSizedRealloc(UriMemoryManager * memory,
+		void * ptr, size_t size) {
+	const UriSizedHeader * header;
+	void * newBuffer;
+
+	if (memory == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if (ptr == NULL) {
+		return memory->malloc(memory, size);
+	}
+
+	if (size == 0) {
+		memory->free(memory, ptr);
+		return NULL;
+	}
+
+	header = (const UriSizedHeader *)((char *)ptr - sizeof(UriSizedHeader));
+
+	/* Anything to do? */
+	if (size <= header->size) {
+		return ptr;
+	}
+
+	newBuffer = uriSizedMallocKind(memory, size, (UriMemoryKind)header->kind);
+	if (newBuffer == NULL) {
+		/* errno set by malloc */
+		return NULL;
+	}
+
+	memcpy(newBuffer, ptr, header->size);
+
+	memory->free(memory, ptr);
+
+	return newBuffer;
+}
+
+
+
+static void uriSizedFree(UriMemoryManager * memory, void * ptr) {
+	UriSizedMemoryBackend * backend;
+	UriSizedHeader * header;
+
+	if ((ptr == NULL) || (memory == NULL)) {
+		return;
+	}
+
+	backend = (UriSizedMemoryBackend *)memory->userData;
+	if (backend == NULL) {
+		return;
+	}
+
+	header = (UriSizedHeader *)((char *)ptr - sizeof(UriSizedHeader));
+	backend->free(backend, header, sizeof(UriSizedHeader) + header->size,
+			(UriMemoryKind)header->kind);
+}
+
+
+
+int uriCompleteSizedMemoryManager(UriMemoryManager * memory,
+		UriSizedMemoryBackend * backend) {
+	if ((memory == NULL) || (backend == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if ((backend->malloc == NULL) || (backend->free == NULL)) {
+		return URI_ERROR_MEMORY_MANAGER_INCOMPLETE;
+	}
+
+	memory->calloc = uriEmulateCalloc;
+	memory->reallocarray = uriEmulateReallocarray;
+
+	memory->malloc = uriSizedMalloc;
+	memory->realloc = uriSizedRealloc;
+	memory->free = uriSizedFree;
+
+	memory->userData = backend;
+
+	return URI_SUCCESS;
+}
+
+
+
+void * uriMallocKind(UriMemoryManager * memory, size_t size,
+		UriMemoryKind kind) {
+	if (memory->malloc == uriSizedMalloc) {
+		return uriSizedMallocKind(memory, size, kind);
+	}
+	return memory->malloc(memory, size);
+}
+
+
+
+void * uriMallocNode(UriMemoryManager * memory, size_t size,
+		UriMemoryKind kind) {
+	if (memory->malloc == uriSizedMalloc) {
+		UriSizedMemoryBackend * const backend
+				= (UriSizedMemoryBackend *)memory->userData;
+		return backend->malloc(backend, size, kind);
+	}
+	return memory->malloc(memory, size);
+}
+
+
+
+void * uriCallocNode(UriMemoryManager * memory, size_t size,
+		UriMemoryKind kind) {
+	void * buffer;
+
+	if (memory->malloc != uriSizedMalloc) {
+		return memory->calloc(memory, 1, size);
+	}
+
+	buffer = uriMallocNode(memory, size, kind);
+	if (buffer != NULL) {
+		memset(buffer, 0, size);
+	}
+	return buffer;
+}
+
+
+
+void uriFreeNode(UriMemoryManager * memory, void * ptr, size_t size,
+		UriMemoryKind kind) {
+	if (memory->free == uriSizedFree) {
+		UriSizedMemoryBackend * const backend
+				= (UriSizedMemoryBackend *)memory->userData;
+		if (ptr != NULL) {
+			backend->free(backend, ptr, size, kind);
+		}
+		return;
+	}
+	memory->free(memory, ptr);
+}
+
+
+
+UriBlock * uriMallocBlock(UriMemoryManager * memory, size_t dataSize,
+		UriMemoryKind kind) {
+	UriBlock * block;
+
+	if (dataSize > ((size_t)-1) - sizeof(UriBlock)) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	block = uriMallocKind(memory, sizeof(UriBlock) + dataSize, kind);
+	if (block == NULL) {
+		return NULL;
+	}
+	block->size = sizeof(UriBlock) + dataSize;
+	block->charsRequired = -1;
+	return block;
+}
+
+
+
+void uriFreeBlock(UriMemoryManager * memory, UriBlock * block) {
+	memory->free(memory, block);
+}
+
+
+
+UriBool uriBlockContains(const UriBlock * block, const void * ptr) {
+	const char * const first = (const char *)block;
+	return ((block != NULL) && ((const char *)ptr >= first)
+			&& ((const char *)ptr < first + block->size))
+			? URI_TRUE : URI_FALSE;
+}
+
+
+
+#ifdef URI_ATOMIC_C11
+/* Member refCount is a plain long in the public header */
+typedef char uriAtomicLongMatchesLong[
+		(sizeof(atomic_long) == sizeof(long)) ? 1 : -1];
+#endif
+
+
+
+long uriRefCountIncrement(long * refCount) {
+#if defined(URI_ATOMIC_GNUC)
+	return __atomic_add_fetch(refCount, 1, __ATOMIC_RELAXED);
+#elif defined(URI_ATOMIC_MSVC)
+	return _InterlockedIncrement((volatile long *)refCount);
+#else
+	return atomic_fetch_add_explicit((volatile atomic_long *)refCount, 1,
+			memory_order_relaxed) + 1;
+#endif
+}
+
+
+
+long uriRefCountDecrement(long * refCount) {
+	/* Release so that prior reads happen before the final free,
+	 * acquire so that the final free happens after them */
+#if defined(URI_ATOMIC_GNUC)
+	return __atomic_sub_fetch(refCount, 1, __ATOMIC_ACQ_REL);
+#elif defined(URI_ATOMIC_MSVC)
+	return _InterlockedDecrement((volatile long *)refCount);
+#else
+	return atomic_fetch_sub_explicit((volatile atomic_long *)refCount, 1,
+			memory_order_acq_rel) - 1;
+#endif
+}
+
+
+
+static void uriAccountingAdd(UriMemoryStats * stats, size_t size) {
+	stats->bytesCurrent += size;
+	if (stats->bytesCurrent > stats->bytesPeak) {
+		stats->bytesPeak = stats->bytesCurrent;
+	}
+}
+
+
+
+static void * uriAccountingMalloc(UriMemoryManager * memory, size_t size) {
+	UriMemoryAccounting * accounting;
+	const size_t extraBytes = sizeof(size_t);
+	void * buffer;
+
+	if ((memory == NULL) || (memory->userData == NULL)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	accounting = (UriMemoryAccounting *)memory->userData;
+	accounting->stats.mallocCalls++;
+
+	/* check for unsigned overflow */
+	if (size > ((size_t)-1) - extraBytes) {
+		accounting->stats.failedCalls++;
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	buffer = accounting->backend->malloc(accounting->backend,
+			extraBytes + size);
+	if (buffer == NULL) {
+		accounting->stats.failedCalls++;
+		return NULL;
+	}
+
+	*(size_t *)buffer = size;
+	uriAccountingAdd(&accounting->stats, size);
+
+	return (char *)buffer + extraBytes;
+}
+
+
+
+static void * uriAccountingCalloc(UriMemoryManager * memory,
+		size_t nmemb, size_t size) {
+	UriMemoryAccounting * accounting;
+	const size_t extraBytes = sizeof(size_t);
+	const size_t total_size = nmemb * size;
+	void * buffer;
+
+	if ((memory == NULL) || (memory->userData == NULL)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	accounting = (UriMemoryAccounting *)memory->userData;
+	accounting->stats.callocCalls++;
+
+	/* check for unsigned overflow */
+	if (((nmemb != 0) && (total_size / nmemb != size))
+			|| (total_size > ((size_t)-1) - extraBytes)) {
+		accounting->stats.failedCalls++;
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	buffer = accounting->backend->calloc(accounting->backend, 1,
+			extraBytes + total_size);
+	if (buffer == NULL) {
+		accounting->stats.failedCalls++;
+		return NULL;
+	}
+
+	*(size_t *)buffer = total_size;
+	uriAccountingAdd(&accounting->stats, total_size);
+
+	return (char *)buffer + extraBytes;
+}
+
+
+
+/* Shared by realloc and reallocarray; call counting is up to the caller */
+static void * uriAccountingResize(UriMemoryAccounting * accounting,
+		void * ptr, size_t size) {
+	const size_t extraBytes = sizeof(size_t);
+	void * prevBuffer;
+	void * newBuffer;
+	size_t prevSize;
+
+	/* man realloc: "If size is equal to zero, and ptr is *not* NULL,
+	 * then the call is equivalent to free(ptr)." */
+	if ((ptr != NULL) && (size == 0)) {
+		prevBuffer = (char *)ptr - extraBytes;
+		accounting->stats.bytesCurrent -= *(size_t *)prevBuffer;
+		accounting->backend->free(accounting->backend, prevBuffer);
+		return NULL;
+	}
+
+	/* check for unsigned overflow */
+	if (size > ((size_t)-1) - extraBytes) {
+		accounting->stats.failedCalls++;
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	if (ptr == NULL) {
+		prevBuffer = NULL;
+		prevSize = 0;
+	} else {
+		prevBuffer = (char *)ptr - extraBytes;
+		prevSize = *(size_t *)prevBuffer;
+	}
+
+	newBuffer = accounting->backend->realloc(accounting->backend,
+			prevBuffer, extraBytes + size);
+	if (newBuffer == NULL) {
+		/* errno set by realloc, previous buffer left untouched */
+		accounting->stats.failedCalls++;
+		return NULL;
+	}
+
+	*(size_t *)newBuffer = size;
+	accounting->stats.bytesCurrent -= prevSize;
+	uriAccountingAdd(&accounting->stats, size);
+
+	return (char *)newBuffer + extraBytes;
+}
+
+
+
+static void * uriAccountingRealloc(UriMemoryManager * memory,
+		void * ptr, size_t size) {
+	UriMemoryAccounting * accounting;
+
+	if ((memory == NULL) || (memory->userData == NULL)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	accounting = (UriMemoryAccounting *)memory->userData;
+	accounting->stats.reallocCalls++;
+
+	return uriAccountingResize(accounting, ptr, size);
+}
+
+
+
+static void * uriAccountingReallocarray(UriMemoryManager * memory,
+		void * ptr, size_t nmemb, size_t size) {
+	UriMemoryAccounting * accounting;
+	const size_t total_size = nmemb * size;
+
+	if ((memory == NULL) || (memory->userData == NULL)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	accounting = (UriMemoryAccounting *)memory->userData;
+	accounting->stats.reallocarrayCalls++;
+
+	/* check for unsigned overflow */
+	if ((nmemb != 0) && (total_size / nmemb != size)) {
+		accounting->stats.failedCalls++;
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	return uriAccountingResize(accounting, ptr, total_size);
+}
+
+
+
+static void uriAccountingFree(UriMemoryManager * memory, void * ptr) {
+	UriMemoryAccounting * accounting;
+	void * buffer;
+
+	if ((memory == NULL) || (memory->userData == NULL)) {
+		return;
+	}
+
+	accounting = (UriMemoryAccounting *)memory->userData;
+	accounting->stats.freeCalls++;
+
+	if (ptr == NULL) {
+		return;
+	}
+
+	buffer = (char *)ptr - sizeof(size_t);
+	accounting->stats.bytesCurrent -= *(size_t *)buffer;
+	accounting->backend->free(accounting->backend, buffer);
+}
+
+
+
+int uriAccountMemoryManager(UriMemoryManager * memory,
+		UriMemoryAccounting * accounting, UriMemoryManager * backend) {
+	if ((memory == NULL) || (accounting == NULL) || (backend == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (uriMemoryManagerIsComplete(backend) != URI_TRUE) {
+		return URI_ERROR_MEMORY_MANAGER_INCOMPLETE;
+	}
+
+	memset(accounting, 0, sizeof(UriMemoryAccounting));
+	accounting->backend = backend;
+
+	memory->malloc = uriAccountingMalloc;
+	memory->calloc = uriAccountingCalloc;
+	memory->realloc = uriAccountingRealloc;
+	memory->reallocarray = uriAccountingReallocarray;
+	memory->free = uriAccountingFree;
+
+	memory->userData = accounting;
+
+	return URI_SUCCESS;
+}
+
+
+
+static UriMemoryAccounting * uriGetAccounting(const UriMemoryManager * memory) {
+	if ((memory->malloc != uriAccountingMalloc)
+			|| (memory->free != uriAccountingFree)) {
+		return NULL;
+	}
+	return (UriMemoryAccounting *)memory->userData;
+}
+
+
+
+int uriGetMemoryStats(const UriMemoryManager * memory,
+		UriMemoryStats * stats) {
+	const UriMemoryAccounting * accounting;
+
+	if ((memory == NULL) || (stats == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	accounting = uriGetAccounting(memory);
+	if (accounting == NULL) {
+		return URI_ERROR_MEMORY_MANAGER_NOT_ACCOUNTING;
+	}
+
+	*stats = accounting->stats;
+	return URI_SUCCESS;
+}
+
+
+
+int uriResetMemoryStats(UriMemoryManager * memory) {
+	UriMemoryAccounting * accounting;
+	size_t bytesCurrent;
+
+	if (memory == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	accounting = uriGetAccounting(memory);
+	if (accounting == NULL) {
+		return URI_ERROR_MEMORY_MANAGER_NOT_ACCOUNTING;
+	}
+
+	bytesCurrent = accounting->stats.bytesCurrent;
+	memset(&accounting->stats, 0, sizeof(UriMemoryStats));
+	accounting->stats.bytesCurrent = bytesCurrent;
+	accounting->stats.bytesPeak = bytesCurrent;
+	return URI_SUCCESS;
+}
+
+
+
 int uriTestMemoryManager(UriMemoryManager * memory) {
 	const size_t mallocSize = 7;
 	const size_t callocNmemb = 3;
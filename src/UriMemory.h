@@ -73,6 +73,42 @@ URIPARSER_EXTERN UriMemoryManager defaultMemoryManager;
 
 UriBool uriMemoryManagerIsComplete(const UriMemoryManager * memory);
 
+/* Allocations that may be released through memory->free */
+void * uriMallocKind(UriMemoryManager * memory, size_t size,
+		UriMemoryKind kind);
+
+/* Fixed-size nodes that must be released through uriFreeNode */
+void * uriMallocNode(UriMemoryManager * memory, size_t size,
+		UriMemoryKind kind);
+void * uriCallocNode(UriMemoryManager * memory, size_t size,
+		UriMemoryKind kind);
+void uriFreeNode(UriMemoryManager * memory, void * ptr, size_t size,
+		UriMemoryKind kind);
+
+
+
+/* Header of a single allocation holding all text of a URI and possibly
+ * its path segment nodes and host data, too; pointed to by the URI's
+ * member "reserved". Nothing inside is ever released on its own. */
+typedef struct UriBlockStruct {
+	size_t size; /* In bytes, including this header */
+	int charsRequired; /* Text length of an immutable URI, -1 if unknown */
+} UriBlock;
+
+/* Start of the data following the header, aligned for pointers */
+#define URI_BLOCK_DATA(block)  ((void *)((UriBlock *)(block) + 1))
+
+UriBlock * uriMallocBlock(UriMemoryManager * memory, size_t dataSize,
+		UriMemoryKind kind);
+void uriFreeBlock(UriMemoryManager * memory, UriBlock * block);
+UriBool uriBlockContains(const UriBlock * block, const void * ptr);
+
+
+
+/* Atomic, returning the new count */
+long uriRefCountIncrement(long * refCount);
+long uriRefCountDecrement(long * refCount);
+
 
 
 #endif /* URI_MEMORY_H */
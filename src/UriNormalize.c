@@ -83,171 +83,114 @@
 static int URI_FUNC(NormalizeSyntaxEngine)(URI_TYPE(Uri) * uri, unsigned int inMask,
 		unsigned int * outMask, UriMemoryManager * memory);
 
-static UriBool URI_FUNC(MakeRangeOwner)(unsigned int * doneMask,
-		unsigned int maskTest, URI_TYPE(TextRange) * range,
+static void URI_FUNC(FixPercentEncodingInplace)(const URI_CHAR * first,
+		const URI_CHAR ** afterLast, UriBool lowercase);
+
+static const URI_CHAR * URI_FUNC(CleanRunEnd)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, UriBool caseMatters);
+static UriBool URI_FUNC(NeedsNormalization)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, UriBool caseMatters);
+
+static UriBool URI_FUNC(NormalizeSchemeBased)(URI_TYPE(Uri) * uri,
+		unsigned int inMask, unsigned int * outMask,
 		UriMemoryManager * memory);
-static UriBool URI_FUNC(MakeOwnerEngine)(URI_TYPE(Uri) * uri,
-		unsigned int * doneMask, UriMemoryManager * memory);
 
-static void URI_FUNC(FixPercentEncodingInplace)(const URI_CHAR * first,
-		const URI_CHAR ** afterLast);
-static UriBool URI_FUNC(FixPercentEncodingMalloc)(const URI_CHAR ** first,
-		const URI_CHAR ** afterLast, UriMemoryManager * memory);
-static void URI_FUNC(FixPercentEncodingEngine)(
-		const URI_CHAR * inFirst, const URI_CHAR * inAfterLast,
-		const URI_CHAR * outFirst, const URI_CHAR ** outAfterLast);
-
-static UriBool URI_FUNC(ContainsUppercaseLetters)(const URI_CHAR * first,
-		const URI_CHAR * afterLast);
-static UriBool URI_FUNC(ContainsUglyPercentEncoding)(const URI_CHAR * first,
-		const URI_CHAR * afterLast);
-
-static void URI_FUNC(LowercaseInplace)(const URI_CHAR * first,
-		const URI_CHAR * afterLast);
-static void URI_FUNC(LowercaseInplaceExceptPercentEncoding)(const URI_CHAR * first,
-		const URI_CHAR * afterLast);
-static UriBool URI_FUNC(LowercaseMalloc)(const URI_CHAR ** first,
-		const URI_CHAR ** afterLast, UriMemoryManager * memory);
-
-static void URI_FUNC(PreventLeakage)(URI_TYPE(Uri) * uri,
-		unsigned int revertMask, UriMemoryManager * memory);
-
-
-
-static URI_INLINE void URI_FUNC(PreventLeakage)(URI_TYPE(Uri) * uri,
-		unsigned int revertMask, UriMemoryManager * memory) {
-	if (revertMask & URI_NORMALIZE_SCHEME) {
-		/* NOTE: A scheme cannot be the empty string
-		 *       so no need to compare .first with .afterLast, here. */
-		memory->free(memory, (URI_CHAR *)uri->scheme.first);
-		uri->scheme.first = NULL;
-		uri->scheme.afterLast = NULL;
-	}
-
-	if (revertMask & URI_NORMALIZE_USER_INFO) {
-		if (uri->userInfo.first != uri->userInfo.afterLast) {
-			memory->free(memory, (URI_CHAR *)uri->userInfo.first);
-		}
-		uri->userInfo.first = NULL;
-		uri->userInfo.afterLast = NULL;
-	}
-
-	if (revertMask & URI_NORMALIZE_HOST) {
-		if (uri->hostData.ipFuture.first != NULL) {
-			/* IPvFuture */
-			/* NOTE: An IPvFuture address cannot be the empty string
-			 *       so no need to compare .first with .afterLast, here. */
-			memory->free(memory, (URI_CHAR *)uri->hostData.ipFuture.first);
-			uri->hostData.ipFuture.first = NULL;
-			uri->hostData.ipFuture.afterLast = NULL;
-			uri->hostText.first = NULL;
-			uri->hostText.afterLast = NULL;
-		} else if (uri->hostText.first != NULL) {
-			/* Regname */
-			if (uri->hostText.first != uri->hostText.afterLast) {
-				memory->free(memory, (URI_CHAR *)uri->hostText.first);
-			}
-			uri->hostText.first = NULL;
-			uri->hostText.afterLast = NULL;
-		}
-	}
 
-	/* NOTE: Port cannot happen! */
 
-	if (revertMask & URI_NORMALIZE_PATH) {
-		URI_TYPE(PathSegment) * walker = uri->pathHead;
-		while (walker != NULL) {
-			URI_TYPE(PathSegment) * const next = walker->next;
-			if (walker->text.afterLast > walker->text.first) {
-				memory->free(memory, (URI_CHAR *)walker->text.first);
-			}
-			memory->free(memory, walker);
-			walker = next;
+/* Finds the end of a run of characters that normalization leaves
+ * alone, i.e. other than '%' (and uppercase letters if caseMatters) */
+static URI_INLINE const URI_CHAR * URI_FUNC(CleanRunEnd)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, UriBool caseMatters) {
+#ifdef URI_PASS_ANSI
+	/* Look at a machine word at a time while possible */
+	const size_t ones = ((size_t)-1) / 0xff;
+	const size_t lows = ones * 0x7f;
+	const size_t highs = ones * 0x80;
+	const size_t percents = ones * (unsigned char)'%';
+
+	while ((size_t)(afterLast - first) >= sizeof(size_t)) {
+		size_t word;
+		size_t percentZeros;
+		size_t uppercase = 0;
+
+		memcpy(&word, first, sizeof(size_t));
+		percentZeros = word ^ percents;
+		percentZeros = (percentZeros - ones) & ~percentZeros;
+		if (caseMatters) {
+			/* Bytes strictly between '@' and '[' */
+			const size_t low7 = word & lows;
+			uppercase = (ones * (127 + (unsigned char)'[') - low7)
+					& ~word & (low7 + ones * (127 - (unsigned char)'@'));
 		}
-		uri->pathHead = NULL;
-		uri->pathTail = NULL;
-	}
-
-	if (revertMask & URI_NORMALIZE_QUERY) {
-		if (uri->query.first != uri->query.afterLast) {
-			memory->free(memory, (URI_CHAR *)uri->query.first);
+		if (((percentZeros | uppercase) & highs) != 0) {
+			break;
 		}
-		uri->query.first = NULL;
-		uri->query.afterLast = NULL;
+		first += sizeof(size_t);
 	}
+#endif
 
-	if (revertMask & URI_NORMALIZE_FRAGMENT) {
-		if (uri->fragment.first != uri->fragment.afterLast) {
-			memory->free(memory, (URI_CHAR *)uri->fragment.first);
+	for (; first < afterLast; first++) {
+		if ((first[0] == _UT('%'))
+				|| (caseMatters
+					&& (first[0] >= _UT('A')) && (first[0] <= _UT('Z')))) {
+			break;
 		}
-		uri->fragment.first = NULL;
-		uri->fragment.afterLast = NULL;
 	}
+	return first;
 }
 
 
 
-static URI_INLINE UriBool URI_FUNC(ContainsUppercaseLetters)(const URI_CHAR * first,
-		const URI_CHAR * afterLast) {
-	if ((first != NULL) && (afterLast != NULL) && (afterLast > first)) {
-		const URI_CHAR * i = first;
-		for (; i < afterLast; i++) {
-			/* 6.2.2.1 Case Normalization: uppercase letters in scheme or host */
-			if ((*i >= _UT('A')) && (*i <= _UT('Z'))) {
-				return URI_TRUE;
-			}
-		}
+/* Tells if normalizing a range would change it: uppercase letters
+ * (if caseMatters), lowercase percent-encodings or percent-encoded
+ * unreserved characters; looks at each character only once */
+static URI_INLINE UriBool URI_FUNC(NeedsNormalization)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, UriBool caseMatters) {
+	const URI_CHAR * i = first;
+
+	if ((first == NULL) || (afterLast == NULL)) {
+		return URI_FALSE;
 	}
-	return URI_FALSE;
-}
 
+	for (;;) {
+		i = URI_FUNC(CleanRunEnd)(i, afterLast, caseMatters);
+		if (i >= afterLast) {
+			return URI_FALSE;
+		}
 
+		if (i[0] != _UT('%')) {
+			/* 6.2.2.1 Case Normalization: uppercase letters in scheme or host */
+			return URI_TRUE;
+		}
 
-static URI_INLINE UriBool URI_FUNC(ContainsUglyPercentEncoding)(const URI_CHAR * first,
-		const URI_CHAR * afterLast) {
-	if ((first != NULL) && (afterLast != NULL) && (afterLast > first)) {
-		const URI_CHAR * i = first;
-		for (; i + 2 < afterLast; i++) {
-			if (i[0] == _UT('%')) {
-				/* 6.2.2.1 Case Normalization: *
-				 * lowercase percent-encodings */
-				if (((i[1] >= _UT('a')) && (i[1] <= _UT('f')))
-						|| ((i[2] >= _UT('a')) && (i[2] <= _UT('f')))) {
+		if (i + 2 < afterLast) {
+			/* 6.2.2.1 Case Normalization: *
+			 * lowercase percent-encodings */
+			if (((i[1] >= _UT('a')) && (i[1] <= _UT('f')))
+					|| ((i[2] >= _UT('a')) && (i[2] <= _UT('f')))) {
+				return URI_TRUE;
+			} else {
+				/* 6.2.2.2 Percent-Encoding Normalization: *
+				 * percent-encoded unreserved characters   */
+				const unsigned char left = URI_FUNC(HexdigToInt)(i[1]);
+				const unsigned char right = URI_FUNC(HexdigToInt)(i[2]);
+				const int code = 16 * left + right;
+				if (uriIsUnreserved(code)) {
 					return URI_TRUE;
-				} else {
-					/* 6.2.2.2 Percent-Encoding Normalization: *
-					 * percent-encoded unreserved characters   */
-					const unsigned char left = URI_FUNC(HexdigToInt)(i[1]);
-					const unsigned char right = URI_FUNC(HexdigToInt)(i[2]);
-					const int code = 16 * left + right;
-					if (uriIsUnreserved(code)) {
-						return URI_TRUE;
-					}
 				}
 			}
-		}
-	}
-	return URI_FALSE;
-}
-
-
 
-static URI_INLINE void URI_FUNC(LowercaseInplace)(const URI_CHAR * first,
-		const URI_CHAR * afterLast) {
-	if ((first != NULL) && (afterLast != NULL) && (afterLast > first)) {
-		URI_CHAR * i = (URI_CHAR *)first;
-		const int lowerUpperDiff = (_UT('a') - _UT('A'));
-		for (; i < afterLast; i++) {
-			if ((*i >= _UT('A')) && (*i <=_UT('Z'))) {
-				*i = (URI_CHAR)(*i + lowerUpperDiff);
-			}
+			/* Uppercase hex digits are what normalization produces */
+			i += 3;
+		} else {
+			i++;
 		}
 	}
 }
 
 
 
-static URI_INLINE void URI_FUNC(LowercaseInplaceExceptPercentEncoding)(const URI_CHAR * first,
+void URI_FUNC(LowercaseInplace)(const URI_CHAR * first,
 		const URI_CHAR * afterLast) {
 	if ((first != NULL) && (afterLast != NULL) && (afterLast > first)) {
 		URI_CHAR * i = (URI_CHAR *)first;
@@ -255,11 +198,6 @@ static URI_INLINE void URI_FUNC(LowercaseInplaceExceptPercentEncoding)(const URI
 		for (; i < afterLast; i++) {
 			if ((*i >= _UT('A')) && (*i <=_UT('Z'))) {
 				*i = (URI_CHAR)(*i + lowerUpperDiff);
-			} else if (*i == _UT('%')) {
-				if (i + 3 >= afterLast) {
-					return;
-				}
-				i += 2;
 			}
 		}
 	}
@@ -267,68 +205,57 @@ static URI_INLINE void URI_FUNC(LowercaseInplaceExceptPercentEncoding)(const URI
 
 
 
-static URI_INLINE UriBool URI_FUNC(LowercaseMalloc)(const URI_CHAR ** first,
-		const URI_CHAR ** afterLast, UriMemoryManager * memory) {
-	int lenInChars;
+/* NOTE: Implementation must stay inplace-compatible */
+void URI_FUNC(FixPercentEncodingEngine)(
+		const URI_CHAR * inFirst, const URI_CHAR * inAfterLast,
+		const URI_CHAR * outFirst, const URI_CHAR ** outAfterLast,
+		UriBool lowercase) {
 	const int lowerUpperDiff = (_UT('a') - _UT('A'));
-	URI_CHAR * buffer;
-	int i = 0;
-
-	if ((first == NULL) || (afterLast == NULL) || (*first == NULL)
-			|| (*afterLast == NULL)) {
-		return URI_FALSE;
-	}
-
-	lenInChars = (int)(*afterLast - *first);
-	if (lenInChars == 0) {
-		return URI_TRUE;
-	} else if (lenInChars < 0) {
-		return URI_FALSE;
-	}
-
-	buffer = memory->malloc(memory, lenInChars * sizeof(URI_CHAR));
-	if (buffer == NULL) {
-		return URI_FALSE;
-	}
+	const URI_CHAR * read = inFirst;
+	URI_CHAR * write = (URI_CHAR *)outFirst;
 
-	for (; i < lenInChars; i++) {
-		if (((*first)[i] >= _UT('A')) && ((*first)[i] <=_UT('Z'))) {
-			buffer[i] = (URI_CHAR)((*first)[i] + lowerUpperDiff);
-		} else {
-			buffer[i] = (*first)[i];
+	for (;;) {
+		/* Move text that stays as is in bulk */
+		const URI_CHAR * const runEnd = URI_FUNC(CleanRunEnd)(read,
+				inAfterLast, lowercase);
+		if (runEnd > read) {
+			const size_t runLen = (size_t)(runEnd - read);
+			if (write != read) {
+				memmove(write, read, runLen * sizeof(URI_CHAR));
+			}
+			write += runLen;
+			read = runEnd;
 		}
-	}
 
-	*first = buffer;
-	*afterLast = buffer + lenInChars;
-	return URI_TRUE;
-}
-
-
-
-/* NOTE: Implementation must stay inplace-compatible */
-static URI_INLINE void URI_FUNC(FixPercentEncodingEngine)(
-		const URI_CHAR * inFirst, const URI_CHAR * inAfterLast,
-		const URI_CHAR * outFirst, const URI_CHAR ** outAfterLast) {
-	URI_CHAR * write = (URI_CHAR *)outFirst;
-	const int lenInChars = (int)(inAfterLast - inFirst);
-	int i = 0;
+		if (read >= inAfterLast) {
+			break;
+		}
 
-	/* All but last two */
-	for (; i + 2 < lenInChars; i++) {
-		if (inFirst[i] != _UT('%')) {
-			write[0] = inFirst[i];
+		if (read[0] != _UT('%')) {
+			/* 6.2.2.1 Case Normalization: uppercase letters in host */
+			write[0] = (URI_CHAR)(read[0] + lowerUpperDiff);
 			write++;
+			read++;
+		} else if ((read + 2 >= inAfterLast)
+				|| ! URI_FUNC(IsHexdig)(read[1])
+				|| ! URI_FUNC(IsHexdig)(read[2])) {
+			/* NOTE: Malformed percent groups (not possible */
+			/*       with parsed URIs) are copied as is     */
+			write[0] = read[0];
+			write++;
+			read++;
 		} else {
 			/* 6.2.2.2 Percent-Encoding Normalization: *
 			 * percent-encoded unreserved characters   */
-			const URI_CHAR one = inFirst[i + 1];
-			const URI_CHAR two = inFirst[i + 2];
-			const unsigned char left = URI_FUNC(HexdigToInt)(one);
-			const unsigned char right = URI_FUNC(HexdigToInt)(two);
+			const unsigned char left = URI_FUNC(HexdigToInt)(read[1]);
+			const unsigned char right = URI_FUNC(HexdigToInt)(read[2]);
 			const int code = 16 * left + right;
 			if (uriIsUnreserved(code)) {
-				write[0] = (URI_CHAR)(code);
+				URI_CHAR c = (URI_CHAR)(code);
+				if (lowercase && (c >= _UT('A')) && (c <= _UT('Z'))) {
+					c = (URI_CHAR)(c + lowerUpperDiff);
+				}
+				write[0] = c;
 				write++;
 			} else {
 				/* 6.2.2.1 Case Normalization: *
@@ -338,222 +265,394 @@ static URI_INLINE void URI_FUNC(FixPercentEncodingEngine)(
 				write[2] = URI_FUNC(HexToLetter)(right);
 				write += 3;
 			}
-
-			i += 2; /* For the two chars of the percent group we just ate */
+			read += 3; /* For the percent group we just ate */
 		}
 	}
 
-	/* Last two */
-	for (; i < lenInChars; i++) {
-		write[0] = inFirst[i];
-		write++;
-	}
-
 	*outAfterLast = write;
 }
 
 
 
 static URI_INLINE void URI_FUNC(FixPercentEncodingInplace)(const URI_CHAR * first,
-		const URI_CHAR ** afterLast) {
+		const URI_CHAR ** afterLast, UriBool lowercase) {
 	/* Death checks */
 	if ((first == NULL) || (afterLast == NULL) || (*afterLast == NULL)) {
 		return;
 	}
 
 	/* Fix inplace */
-	URI_FUNC(FixPercentEncodingEngine)(first, *afterLast, first, afterLast);
+	URI_FUNC(FixPercentEncodingEngine)(first, *afterLast, first, afterLast,
+			lowercase);
 }
 
 
 
-static URI_INLINE UriBool URI_FUNC(FixPercentEncodingMalloc)(const URI_CHAR ** first,
-		const URI_CHAR ** afterLast, UriMemoryManager * memory) {
-	int lenInChars;
-	URI_CHAR * buffer;
+unsigned int URI_FUNC(NormalizeSyntaxMaskRequired)(const URI_TYPE(Uri) * uri) {
+	unsigned int outMask = URI_NORMALIZED;  /* for NULL uri */
+	URI_FUNC(NormalizeSyntaxMaskRequiredEx)(uri, &outMask);
+	return outMask;
+}
 
-	/* Death checks */
-	if ((first == NULL) || (afterLast == NULL)
-			|| (*first == NULL) || (*afterLast == NULL)) {
-		return URI_FALSE;
-	}
 
-	/* Old text length */
-	lenInChars = (int)(*afterLast - *first);
-	if (lenInChars == 0) {
-		return URI_TRUE;
-	} else if (lenInChars < 0) {
-		return URI_FALSE;
+
+/* Inspects a URI without modifying it; scheme-based steps
+ * are only looked at if they are in inMask */
+static int URI_FUNC(MaskRequiredEngine)(const URI_TYPE(Uri) * uri,
+		unsigned int inMask, unsigned int * outMask) {
+	UriMemoryManager * const memory = NULL;  /* no use of memory manager */
+
+#if defined(__GNUC__) && ((__GNUC__ > 4) \
+		|| ((__GNUC__ == 4) && defined(__GNUC_MINOR__) && (__GNUC_MINOR__ >= 2)))
+	/* Slower code that fixes a warning, not sure if this is a smart idea */
+	URI_TYPE(Uri) writeableClone;
+#endif
+
+	if ((uri == NULL) || (outMask == NULL)) {
+		return URI_ERROR_NULL;
 	}
 
-	/* New buffer */
-	buffer = memory->malloc(memory, lenInChars * sizeof(URI_CHAR));
-	if (buffer == NULL) {
-		return URI_FALSE;
+#if defined(__GNUC__) && ((__GNUC__ > 4) \
+		|| ((__GNUC__ == 4) && defined(__GNUC_MINOR__) && (__GNUC_MINOR__ >= 2)))
+	/* Slower code that fixes a warning, not sure if this is a smart idea */
+	memcpy(&writeableClone, uri, 1 * sizeof(URI_TYPE(Uri)));
+	URI_FUNC(NormalizeSyntaxEngine)(&writeableClone, inMask, outMask, memory);
+#else
+	URI_FUNC(NormalizeSyntaxEngine)((URI_TYPE(Uri) *)uri, inMask, outMask, memory);
+#endif
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(NormalizeSyntaxMaskRequiredEx)(const URI_TYPE(Uri) * uri,
+		unsigned int * outMask) {
+	/* Syntax-based only, matching uriNormalizeSyntaxA */
+	return URI_FUNC(MaskRequiredEngine)(uri, URI_NORMALIZED, outMask);
+}
+
+
+
+int URI_FUNC(NormalizeMaskRequired)(const URI_TYPE(Uri) * uri,
+		unsigned int inMask, unsigned int * outMask) {
+	int res;
+
+	/* Scheme-based steps need to be asked for explicitly */
+	inMask = URI_NORMALIZE_EFFECTIVE_MASK(inMask);
+
+	res = URI_FUNC(MaskRequiredEngine)(uri, inMask, outMask);
+	if (res != URI_SUCCESS) {
+		return res;
 	}
+	*outMask &= inMask;
+	return URI_SUCCESS;
+}
 
-	/* Fix on copy */
-	URI_FUNC(FixPercentEncodingEngine)(*first, *afterLast, buffer, afterLast);
-	*first = buffer;
-	return URI_TRUE;
+
+
+int URI_FUNC(NormalizeSyntaxEx)(URI_TYPE(Uri) * uri, unsigned int mask) {
+	return URI_FUNC(NormalizeSyntaxExMm)(uri, mask, NULL);
 }
 
 
 
-static URI_INLINE UriBool URI_FUNC(MakeRangeOwner)(unsigned int * doneMask,
-		unsigned int maskTest, URI_TYPE(TextRange) * range,
+int URI_FUNC(NormalizeSyntaxExMm)(URI_TYPE(Uri) * uri, unsigned int mask,
 		UriMemoryManager * memory) {
-	if (((*doneMask & maskTest) == 0)
-			&& (range->first != NULL)
-			&& (range->afterLast != NULL)
-			&& (range->afterLast > range->first)) {
-		const int lenInChars = (int)(range->afterLast - range->first);
-		const int lenInBytes = lenInChars * sizeof(URI_CHAR);
-		URI_CHAR * dup = memory->malloc(memory, lenInBytes);
-		if (dup == NULL) {
-			return URI_FALSE; /* Raises malloc error */
-		}
-		memcpy(dup, range->first, lenInBytes);
-		range->first = dup;
-		range->afterLast = dup + lenInChars;
-		*doneMask |= maskTest;
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+	return URI_FUNC(NormalizeSyntaxEngine)(uri, mask, NULL, memory);
+}
+
+
+
+int URI_FUNC(NormalizeSyntax)(URI_TYPE(Uri) * uri) {
+	return URI_FUNC(NormalizeSyntaxEx)(uri, (unsigned int)-1);
+}
+
+
+
+/* Length of a range worth copying, zero for unset or empty ranges */
+static URI_INLINE size_t URI_FUNC(BlockRangeLength)(
+		const URI_TYPE(TextRange) * range) {
+	if ((range->first == NULL) || (range->afterLast == NULL)
+			|| (range->afterLast <= range->first)) {
+		return 0;
 	}
-	return URI_TRUE;
+	return (size_t)(range->afterLast - range->first);
 }
 
 
 
-static URI_INLINE UriBool URI_FUNC(MakeOwnerEngine)(URI_TYPE(Uri) * uri,
-		unsigned int * doneMask, UriMemoryManager * memory) {
-	URI_TYPE(PathSegment) * walker = uri->pathHead;
-	if (!URI_FUNC(MakeRangeOwner)(doneMask, URI_NORMALIZE_SCHEME,
-				&(uri->scheme), memory)
-			|| !URI_FUNC(MakeRangeOwner)(doneMask, URI_NORMALIZE_USER_INFO,
-				&(uri->userInfo), memory)
-			|| !URI_FUNC(MakeRangeOwner)(doneMask, URI_NORMALIZE_QUERY,
-				&(uri->query), memory)
-			|| !URI_FUNC(MakeRangeOwner)(doneMask, URI_NORMALIZE_FRAGMENT,
-				&(uri->fragment), memory)) {
-		return URI_FALSE; /* Raises malloc error */
+/* Moves a range into the text block at *write, fixing percent-encodings
+ * and case on the way if requested; unset and empty ranges stay where
+ * they are */
+static URI_INLINE void URI_FUNC(CopyRangeToBlock)(URI_TYPE(TextRange) * range,
+		UriBool fixPercentEncoding, UriBool lowercase, URI_CHAR ** write) {
+	const size_t lenInChars = URI_FUNC(BlockRangeLength)(range);
+	URI_CHAR * const first = *write;
+
+	if (lenInChars == 0) {
+		return;
 	}
 
-	/* Host */
-	if ((*doneMask & URI_NORMALIZE_HOST) == 0) {
-		if (uri->hostData.ipFuture.first != NULL) {
-			/* IPvFuture */
-			if (!URI_FUNC(MakeRangeOwner)(doneMask, URI_NORMALIZE_HOST,
-					&(uri->hostData.ipFuture), memory)) {
-				return URI_FALSE; /* Raises malloc error */
-			}
-			uri->hostText.first = uri->hostData.ipFuture.first;
-			uri->hostText.afterLast = uri->hostData.ipFuture.afterLast;
-		} else if (uri->hostText.first != NULL) {
-			/* Regname */
-			if (!URI_FUNC(MakeRangeOwner)(doneMask, URI_NORMALIZE_HOST,
-					&(uri->hostText), memory)) {
-				return URI_FALSE; /* Raises malloc error */
-			}
+	if (fixPercentEncoding) {
+		URI_FUNC(FixPercentEncodingEngine)(range->first, range->afterLast,
+				first, &(range->afterLast), lowercase);
+	} else {
+		memcpy(first, range->first, lenInChars * sizeof(URI_CHAR));
+		range->afterLast = first + lenInChars;
+		if (lowercase) {
+			URI_FUNC(LowercaseInplace)(first, range->afterLast);
 		}
 	}
+	range->first = first;
+	*write = (URI_CHAR *)range->afterLast;
+}
 
-	/* Path */
-	if ((*doneMask & URI_NORMALIZE_PATH) == 0) {
-		while (walker != NULL) {
-			if (!URI_FUNC(MakeRangeOwner)(doneMask, 0, &(walker->text), memory)) {
-				/* Free allocations done so far and kill path */
-
-				/* Kill path to one before walker (if any) */
-				URI_TYPE(PathSegment) * ranger = uri->pathHead;
-				while (ranger != walker) {
-					URI_TYPE(PathSegment) * const next = ranger->next;
-					if ((ranger->text.first != NULL)
-							&& (ranger->text.afterLast != NULL)
-							&& (ranger->text.afterLast > ranger->text.first)) {
-						memory->free(memory, (URI_CHAR *)ranger->text.first);
-					}
-					memory->free(memory, ranger);
-					ranger = next;
-				}
 
-				/* Kill path from walker */
-				while (walker != NULL) {
-					URI_TYPE(PathSegment) * const next = walker->next;
-					memory->free(memory, walker);
-					walker = next;
-				}
 
-				uri->pathHead = NULL;
-				uri->pathTail = NULL;
-				return URI_FALSE; /* Raises malloc error */
-			}
-			walker = walker->next;
-		}
-		*doneMask |= URI_NORMALIZE_PATH;
+/* Makes a non-owner URI owner of all of its text, normalizing the
+ * components in inMask while copying them into a single block;
+ * leaves the URI untouched on failure */
+static URI_INLINE UriBool URI_FUNC(NormalizeIntoBlock)(URI_TYPE(Uri) * uri,
+		unsigned int inMask, UriMemoryManager * memory) {
+	URI_TYPE(PathSegment) * walker;
+	URI_TYPE(TextRange) * host = NULL;
+	size_t lenInChars;
+	UriBlock * block;
+	URI_CHAR * write;
+
+	if (uri->hostData.ipFuture.first != NULL) {
+		host = &(uri->hostData.ipFuture);
+	} else if (uri->hostText.first != NULL) {
+		host = &(uri->hostText);
+	}
+
+	/* Normalization never makes text longer */
+	lenInChars = URI_FUNC(BlockRangeLength)(&(uri->scheme))
+			+ URI_FUNC(BlockRangeLength)(&(uri->userInfo))
+			+ ((host != NULL) ? URI_FUNC(BlockRangeLength)(host) : 0)
+			+ URI_FUNC(BlockRangeLength)(&(uri->portText))
+			+ URI_FUNC(BlockRangeLength)(&(uri->query))
+			+ URI_FUNC(BlockRangeLength)(&(uri->fragment));
+	for (walker = uri->pathHead; walker != NULL; walker = walker->next) {
+		lenInChars += URI_FUNC(BlockRangeLength)(&(walker->text));
+	}
+
+	if (lenInChars == 0) {
+		/* Nothing to copy */
+		uri->owner = URI_TRUE;
+		return URI_TRUE;
+	}
+
+	if (lenInChars > ((size_t)-1) / sizeof(URI_CHAR)) {
+		return URI_FALSE; /* Raises malloc error */
 	}
 
-	/* Port text, must come last so we don't have to undo that one if it fails. *
-	 * Otherwise we would need and extra enum flag for it although the port      *
-	 * cannot go unnormalized...                                                */
-	if (!URI_FUNC(MakeRangeOwner)(doneMask, 0, &(uri->portText), memory)) {
+	block = uriMallocBlock(memory, lenInChars * sizeof(URI_CHAR), URI_MEMORY_TEXT);
+	if (block == NULL) {
 		return URI_FALSE; /* Raises malloc error */
 	}
+	write = URI_BLOCK_DATA(block);
 
+	/* Scheme */
+	URI_FUNC(CopyRangeToBlock)(&(uri->scheme), URI_FALSE,
+			(inMask & URI_NORMALIZE_SCHEME) ? URI_TRUE : URI_FALSE, &write);
+
+	/* User info */
+	URI_FUNC(CopyRangeToBlock)(&(uri->userInfo),
+			(inMask & URI_NORMALIZE_USER_INFO) ? URI_TRUE : URI_FALSE,
+			URI_FALSE, &write);
+
+	/* Host */
+	if (host == &(uri->hostData.ipFuture)) {
+		/* IPvFuture */
+		URI_FUNC(CopyRangeToBlock)(host, URI_FALSE,
+				(inMask & URI_NORMALIZE_HOST) ? URI_TRUE : URI_FALSE, &write);
+		uri->hostText.first = host->first;
+		uri->hostText.afterLast = host->afterLast;
+	} else if (host != NULL) {
+		/* Regname, IPv4 or IPv6 */
+		const UriBool normalizeHost = ((inMask & URI_NORMALIZE_HOST)
+				&& (uri->hostData.ip4 == NULL)) ? URI_TRUE : URI_FALSE;
+		URI_FUNC(CopyRangeToBlock)(host, normalizeHost, normalizeHost, &write);
+	}
+
+	/* Port */
+	URI_FUNC(CopyRangeToBlock)(&(uri->portText), URI_FALSE, URI_FALSE, &write);
+
+	/* Path */
+	for (walker = uri->pathHead; walker != NULL; walker = walker->next) {
+		URI_FUNC(CopyRangeToBlock)(&(walker->text),
+				(inMask & URI_NORMALIZE_PATH) ? URI_TRUE : URI_FALSE,
+				URI_FALSE, &write);
+	}
+
+	/* Query, fragment */
+	URI_FUNC(CopyRangeToBlock)(&(uri->query),
+			(inMask & URI_NORMALIZE_QUERY) ? URI_TRUE : URI_FALSE,
+			URI_FALSE, &write);
+	URI_FUNC(CopyRangeToBlock)(&(uri->fragment),
+			(inMask & URI_NORMALIZE_FRAGMENT) ? URI_TRUE : URI_FALSE,
+			URI_FALSE, &write);
+
+	uri->reserved = block;
+	uri->owner = URI_TRUE;
 	return URI_TRUE;
 }
 
 
 
-unsigned int URI_FUNC(NormalizeSyntaxMaskRequired)(const URI_TYPE(Uri) * uri) {
-	unsigned int outMask = URI_NORMALIZED;  /* for NULL uri */
-	URI_FUNC(NormalizeSyntaxMaskRequiredEx)(uri, &outMask);
-	return outMask;
+/* 6.2.2.3 Path Segment Normalization */
+static URI_INLINE UriBool URI_FUNC(NormalizePathSegments)(URI_TYPE(Uri) * uri,
+		UriMemoryManager * memory) {
+	const UriBool relative = ((uri->scheme.first == NULL)
+			&& !uri->absolutePath) ? URI_TRUE : URI_FALSE;
+
+	if (!URI_FUNC(RemoveDotSegmentsEx)(uri, relative, uri->owner, memory)) {
+		return URI_FALSE; /* Raises malloc error */
+	}
+	URI_FUNC(FixEmptyTrailSegment)(uri, memory);
+	return URI_TRUE;
 }
 
 
 
-int URI_FUNC(NormalizeSyntaxMaskRequiredEx)(const URI_TYPE(Uri) * uri,
-		unsigned int * outMask) {
-	UriMemoryManager * const memory = NULL;  /* no use of memory manager */
+static const UriSchemeDefaults * URI_FUNC(FindSchemeDefaults)(
+		const URI_TYPE(Uri) * uri) {
+	const UriSchemeDefaults * defaults = uriSchemeDefaults;
+	const size_t lenInChars = (size_t)(uri->scheme.afterLast - uri->scheme.first);
 
-#if defined(__GNUC__) && ((__GNUC__ > 4) \
-		|| ((__GNUC__ == 4) && defined(__GNUC_MINOR__) && (__GNUC_MINOR__ >= 2)))
-	/* Slower code that fixes a warning, not sure if this is a smart idea */
-	URI_TYPE(Uri) writeableClone;
-#endif
+	if (uri->scheme.first == NULL) {
+		return NULL;
+	}
 
-	if ((uri == NULL) || (outMask == NULL)) {
-		return URI_ERROR_NULL;
+	for (; defaults->name != NULL; defaults++) {
+		size_t i = 0;
+		for (; i < lenInChars; i++) {
+			URI_CHAR c = uri->scheme.first[i];
+			if ((c >= _UT('A')) && (c <= _UT('Z'))) {
+				c = (URI_CHAR)(c + (_UT('a') - _UT('A')));
+			}
+			if ((defaults->name[i] == '\0')
+					|| (c != (URI_CHAR)defaults->name[i])) {
+				break;
+			}
+		}
+		if ((i == lenInChars) && (defaults->name[i] == '\0')) {
+			return defaults;
+		}
 	}
+	return NULL;
+}
 
-#if defined(__GNUC__) && ((__GNUC__ > 4) \
-		|| ((__GNUC__ == 4) && defined(__GNUC_MINOR__) && (__GNUC_MINOR__ >= 2)))
-	/* Slower code that fixes a warning, not sure if this is a smart idea */
-	memcpy(&writeableClone, uri, 1 * sizeof(URI_TYPE(Uri)));
-	URI_FUNC(NormalizeSyntaxEngine)(&writeableClone, 0, outMask, memory);
-#else
-	URI_FUNC(NormalizeSyntaxEngine)((URI_TYPE(Uri) *)uri, 0, outMask, memory);
-#endif
-	return URI_SUCCESS;
+
+
+/* 6.2.3 Scheme-Based Normalization: an explicit ":port" for which the port
+ * is empty or the default for the scheme can be elided */
+UriBool URI_FUNC(IsPortRedundant)(const URI_TYPE(Uri) * uri) {
+	const UriSchemeDefaults * defaults;
+	const URI_CHAR * i;
+	unsigned int port = 0;
+
+	if (uri->portText.first == NULL) {
+		return URI_FALSE;
+	} else if (uri->portText.first == uri->portText.afterLast) {
+		return URI_TRUE;
+	}
+
+	defaults = URI_FUNC(FindSchemeDefaults)(uri);
+	if (defaults == NULL) {
+		return URI_FALSE;
+	}
+
+	for (i = uri->portText.first; i < uri->portText.afterLast; i++) {
+		port = 10 * port + (unsigned int)(*i - _UT('0'));
+		if (port > 65535) {
+			return URI_FALSE;
+		}
+	}
+	return (port == defaults->defaultPort) ? URI_TRUE : URI_FALSE;
 }
 
 
 
-int URI_FUNC(NormalizeSyntaxEx)(URI_TYPE(Uri) * uri, unsigned int mask) {
-	return URI_FUNC(NormalizeSyntaxExMm)(uri, mask, NULL);
+/* 6.2.3 Scheme-Based Normalization: "http://example.com" becomes
+ * "http://example.com/" */
+UriBool URI_FUNC(IsEmptyPathRoot)(const URI_TYPE(Uri) * uri) {
+	const UriSchemeDefaults * defaults;
+
+	if ((uri->pathHead != NULL) || uri->absolutePath
+			|| !URI_FUNC(IsHostSet)(uri)) {
+		return URI_FALSE;
+	}
+
+	defaults = URI_FUNC(FindSchemeDefaults)(uri);
+	return ((defaults != NULL) && defaults->emptyPathIsRoot)
+			? URI_TRUE : URI_FALSE;
 }
 
 
 
-int URI_FUNC(NormalizeSyntaxExMm)(URI_TYPE(Uri) * uri, unsigned int mask,
-		UriMemoryManager * memory) {
-	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
-	return URI_FUNC(NormalizeSyntaxEngine)(uri, mask, NULL, memory);
+/* Drops a range the URI may own; text in a single block stays
+ * where it is, see NormalizeIntoBlock */
+static URI_INLINE void URI_FUNC(DropRange)(URI_TYPE(Uri) * uri,
+		URI_TYPE(TextRange) * range, UriMemoryManager * memory) {
+	if (uri->owner && (uri->reserved == NULL)
+			&& (range->first != range->afterLast)) {
+		memory->free(memory, (URI_CHAR *)range->first);
+	}
+	range->first = NULL;
+	range->afterLast = NULL;
 }
 
 
 
-int URI_FUNC(NormalizeSyntax)(URI_TYPE(Uri) * uri) {
-	return URI_FUNC(NormalizeSyntaxEx)(uri, (unsigned int)-1);
+/* Handles the steps beyond syntax-based normalization; inspection only
+ * reports the steps in inMask, and never the optional ones dropping
+ * the empty query and the fragment */
+static UriBool URI_FUNC(NormalizeSchemeBased)(URI_TYPE(Uri) * uri,
+		unsigned int inMask, unsigned int * outMask,
+		UriMemoryManager * memory) {
+	if (outMask != NULL) {
+		if ((inMask & URI_NORMALIZE_PORT) && URI_FUNC(IsPortRedundant)(uri)) {
+			*outMask |= URI_NORMALIZE_PORT;
+		}
+		if ((inMask & URI_NORMALIZE_EMPTY_PATH) && URI_FUNC(IsEmptyPathRoot)(uri)) {
+			*outMask |= URI_NORMALIZE_EMPTY_PATH;
+		}
+		return URI_TRUE;
+	}
+
+	/* Port */
+	if ((inMask & URI_NORMALIZE_PORT) && URI_FUNC(IsPortRedundant)(uri)) {
+		URI_FUNC(DropRange)(uri, &(uri->portText), memory);
+	}
+
+	/* Empty path */
+	if ((inMask & URI_NORMALIZE_EMPTY_PATH) && URI_FUNC(IsEmptyPathRoot)(uri)) {
+		URI_TYPE(PathSegment) * const segment = uriCallocNode(memory,
+				sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
+		if (segment == NULL) {
+			return URI_FALSE; /* Raises malloc error */
+		}
+		segment->text.first = URI_FUNC(SafeToPointTo);
+		segment->text.afterLast = URI_FUNC(SafeToPointTo);
+		uri->pathHead = segment;
+		uri->pathTail = segment;
+	}
+
+	/* Empty query */
+	if ((inMask & URI_NORMALIZE_EMPTY_QUERY) && (uri->query.first != NULL)
+			&& (uri->query.first == uri->query.afterLast)) {
+		URI_FUNC(DropRange)(uri, &(uri->query), memory);
+	}
+
+	/* Fragment */
+	if ((inMask & URI_NORMALIZE_DROP_FRAGMENT) && (uri->fragment.first != NULL)) {
+		URI_FUNC(DropRange)(uri, &(uri->fragment), memory);
+	}
+
+	return URI_TRUE;
 }
 
 
@@ -561,8 +660,6 @@ int URI_FUNC(NormalizeSyntax)(URI_TYPE(Uri) * uri) {
 static URI_INLINE int URI_FUNC(NormalizeSyntaxEngine)(URI_TYPE(Uri) * uri,
 		unsigned int inMask, unsigned int * outMask,
 		UriMemoryManager * memory) {
-	unsigned int doneMask = URI_NORMALIZED;
-
 	/* Not just doing inspection? -> memory manager required! */
 	if (outMask == NULL) {
 		assert(memory != NULL);
@@ -583,100 +680,76 @@ static URI_INLINE int URI_FUNC(NormalizeSyntaxEngine)(URI_TYPE(Uri) * uri,
 	} else if (inMask == URI_NORMALIZED) {
 		/* Nothing to do */
 		return URI_SUCCESS;
+	} else {
+		/* Scheme-based steps need to be asked for explicitly */
+		inMask = URI_NORMALIZE_EFFECTIVE_MASK(inMask);
+	}
+
+	if ((outMask == NULL) && !uri->owner) {
+		/* Normalize on copy, all text goes into a single block */
+		if (!URI_FUNC(NormalizeIntoBlock)(uri, inMask, memory)) {
+			return URI_ERROR_MALLOC;
+		}
+
+		if ((inMask & URI_NORMALIZE_PATH)
+				&& !URI_FUNC(NormalizePathSegments)(uri, memory)) {
+			return URI_ERROR_MALLOC;
+		}
+
+		if (!URI_FUNC(NormalizeSchemeBased)(uri, inMask, NULL, memory)) {
+			return URI_ERROR_MALLOC;
+		}
+		return URI_SUCCESS;
 	}
 
 	/* Scheme, host */
 	if (outMask != NULL) {
-		const UriBool normalizeScheme = URI_FUNC(ContainsUppercaseLetters)(
-				uri->scheme.first, uri->scheme.afterLast);
-		const UriBool normalizeHostCase = URI_FUNC(ContainsUppercaseLetters)(
-			uri->hostText.first, uri->hostText.afterLast);
+		const UriBool normalizeScheme = URI_FUNC(NeedsNormalization)(
+				uri->scheme.first, uri->scheme.afterLast, URI_TRUE);
+		const UriBool normalizeHost = URI_FUNC(NeedsNormalization)(
+			uri->hostText.first, uri->hostText.afterLast, URI_TRUE);
 		if (normalizeScheme) {
 			*outMask |= URI_NORMALIZE_SCHEME;
 		}
 
-		if (normalizeHostCase) {
+		if (normalizeHost) {
 			*outMask |= URI_NORMALIZE_HOST;
-		} else {
-			const UriBool normalizeHostPrecent = URI_FUNC(ContainsUglyPercentEncoding)(
-					uri->hostText.first, uri->hostText.afterLast);
-			if (normalizeHostPrecent) {
-				*outMask |= URI_NORMALIZE_HOST;
-			}
 		}
 	} else {
 		/* Scheme */
 		if ((inMask & URI_NORMALIZE_SCHEME) && (uri->scheme.first != NULL)) {
-			if (uri->owner) {
-				URI_FUNC(LowercaseInplace)(uri->scheme.first, uri->scheme.afterLast);
-			} else {
-				if (!URI_FUNC(LowercaseMalloc)(&(uri->scheme.first), &(uri->scheme.afterLast), memory)) {
-					URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-					return URI_ERROR_MALLOC;
-				}
-				doneMask |= URI_NORMALIZE_SCHEME;
-			}
+			URI_FUNC(LowercaseInplace)(uri->scheme.first, uri->scheme.afterLast);
 		}
 
 		/* Host */
 		if (inMask & URI_NORMALIZE_HOST) {
 			if (uri->hostData.ipFuture.first != NULL) {
 				/* IPvFuture */
-				if (uri->owner) {
-					URI_FUNC(LowercaseInplace)(uri->hostData.ipFuture.first,
-							uri->hostData.ipFuture.afterLast);
-				} else {
-					if (!URI_FUNC(LowercaseMalloc)(&(uri->hostData.ipFuture.first),
-							&(uri->hostData.ipFuture.afterLast), memory)) {
-						URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-						return URI_ERROR_MALLOC;
-					}
-					doneMask |= URI_NORMALIZE_HOST;
-				}
+				URI_FUNC(LowercaseInplace)(uri->hostData.ipFuture.first,
+						uri->hostData.ipFuture.afterLast);
 				uri->hostText.first = uri->hostData.ipFuture.first;
 				uri->hostText.afterLast = uri->hostData.ipFuture.afterLast;
 			} else if ((uri->hostText.first != NULL)
 					&& (uri->hostData.ip4 == NULL)) {
 				/* Regname or IPv6 */
-				if (uri->owner) {
-					URI_FUNC(FixPercentEncodingInplace)(uri->hostText.first,
-							&(uri->hostText.afterLast));
-				} else {
-					if (!URI_FUNC(FixPercentEncodingMalloc)(
-							&(uri->hostText.first),
-							&(uri->hostText.afterLast),
-							memory)) {
-						URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-						return URI_ERROR_MALLOC;
-					}
-					doneMask |= URI_NORMALIZE_HOST;
-				}
-
-				URI_FUNC(LowercaseInplaceExceptPercentEncoding)(uri->hostText.first,
-						uri->hostText.afterLast);
+				URI_FUNC(FixPercentEncodingInplace)(uri->hostText.first,
+						&(uri->hostText.afterLast), URI_TRUE);
 			}
 		}
 	}
 
 	/* User info */
 	if (outMask != NULL) {
-		const UriBool normalizeUserInfo = URI_FUNC(ContainsUglyPercentEncoding)(
-			uri->userInfo.first, uri->userInfo.afterLast);
+		const UriBool normalizeUserInfo = URI_FUNC(NeedsNormalization)(
+			uri->userInfo.first, uri->userInfo.afterLast,
+			URI_FALSE);
 		if (normalizeUserInfo) {
 			*outMask |= URI_NORMALIZE_USER_INFO;
 		}
 	} else {
 		if ((inMask & URI_NORMALIZE_USER_INFO) && (uri->userInfo.first != NULL)) {
-			if (uri->owner) {
-				URI_FUNC(FixPercentEncodingInplace)(uri->userInfo.first, &(uri->userInfo.afterLast));
-			} else {
-				if (!URI_FUNC(FixPercentEncodingMalloc)(&(uri->userInfo.first),
-						&(uri->userInfo.afterLast), memory)) {
-					URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-					return URI_ERROR_MALLOC;
-				}
-				doneMask |= URI_NORMALIZE_USER_INFO;
-			}
+			URI_FUNC(FixPercentEncodingInplace)(uri->userInfo.first,
+					&(uri->userInfo.afterLast), URI_FALSE);
 		}
 	}
 
@@ -697,7 +770,7 @@ static URI_INLINE int URI_FUNC(NormalizeSyntaxEngine)(URI_TYPE(Uri) * uri,
 							&& (first[0] == _UT('.'))
 							&& (first[1] == _UT('.')))
 						||
-						URI_FUNC(ContainsUglyPercentEncoding)(first, afterLast)
+						URI_FUNC(NeedsNormalization)(first, afterLast, URI_FALSE)
 					)) {
 				*outMask |= URI_NORMALIZE_PATH;
 				break;
@@ -705,46 +778,27 @@ static URI_INLINE int URI_FUNC(NormalizeSyntaxEngine)(URI_TYPE(Uri) * uri,
 			walker = walker->next;
 		}
 	} else if (inMask & URI_NORMALIZE_PATH) {
-		URI_TYPE(PathSegment) * walker;
-		const UriBool relative = ((uri->scheme.first == NULL)
-				&& !uri->absolutePath) ? URI_TRUE : URI_FALSE;
-
 		/* Fix percent-encoding for each segment */
-		walker = uri->pathHead;
-		if (uri->owner) {
-			while (walker != NULL) {
-				URI_FUNC(FixPercentEncodingInplace)(walker->text.first, &(walker->text.afterLast));
-				walker = walker->next;
-			}
-		} else {
-			while (walker != NULL) {
-				if (!URI_FUNC(FixPercentEncodingMalloc)(&(walker->text.first),
-						&(walker->text.afterLast), memory)) {
-					URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-					return URI_ERROR_MALLOC;
-				}
-				walker = walker->next;
-			}
-			doneMask |= URI_NORMALIZE_PATH;
+		URI_TYPE(PathSegment) * walker = uri->pathHead;
+		while (walker != NULL) {
+			URI_FUNC(FixPercentEncodingInplace)(walker->text.first,
+					&(walker->text.afterLast), URI_FALSE);
+			walker = walker->next;
 		}
 
-		/* 6.2.2.3 Path Segment Normalization */
-		if (!URI_FUNC(RemoveDotSegmentsEx)(uri, relative,
-				(uri->owner == URI_TRUE)
-				|| ((doneMask & URI_NORMALIZE_PATH) != 0),
-				memory)) {
-			URI_FUNC(PreventLeakage)(uri, doneMask, memory);
+		if (!URI_FUNC(NormalizePathSegments)(uri, memory)) {
 			return URI_ERROR_MALLOC;
 		}
-		URI_FUNC(FixEmptyTrailSegment)(uri, memory);
 	}
 
 	/* Query, fragment */
 	if (outMask != NULL) {
-		const UriBool normalizeQuery = URI_FUNC(ContainsUglyPercentEncoding)(
-				uri->query.first, uri->query.afterLast);
-		const UriBool normalizeFragment = URI_FUNC(ContainsUglyPercentEncoding)(
-				uri->fragment.first, uri->fragment.afterLast);
+		const UriBool normalizeQuery = URI_FUNC(NeedsNormalization)(
+				uri->query.first, uri->query.afterLast,
+				URI_FALSE);
+		const UriBool normalizeFragment = URI_FUNC(NeedsNormalization)(
+				uri->fragment.first, uri->fragment.afterLast,
+				URI_FALSE);
 		if (normalizeQuery) {
 			*outMask |= URI_NORMALIZE_QUERY;
 		}
@@ -755,40 +809,20 @@ static URI_INLINE int URI_FUNC(NormalizeSyntaxEngine)(URI_TYPE(Uri) * uri,
 	} else {
 		/* Query */
 		if ((inMask & URI_NORMALIZE_QUERY) && (uri->query.first != NULL)) {
-			if (uri->owner) {
-				URI_FUNC(FixPercentEncodingInplace)(uri->query.first, &(uri->query.afterLast));
-			} else {
-				if (!URI_FUNC(FixPercentEncodingMalloc)(&(uri->query.first),
-						&(uri->query.afterLast), memory)) {
-					URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-					return URI_ERROR_MALLOC;
-				}
-				doneMask |= URI_NORMALIZE_QUERY;
-			}
+			URI_FUNC(FixPercentEncodingInplace)(uri->query.first,
+					&(uri->query.afterLast), URI_FALSE);
 		}
 
 		/* Fragment */
 		if ((inMask & URI_NORMALIZE_FRAGMENT) && (uri->fragment.first != NULL)) {
-			if (uri->owner) {
-				URI_FUNC(FixPercentEncodingInplace)(uri->fragment.first, &(uri->fragment.afterLast));
-			} else {
-				if (!URI_FUNC(FixPercentEncodingMalloc)(&(uri->fragment.first),
-						&(uri->fragment.afterLast), memory)) {
-					URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-					return URI_ERROR_MALLOC;
-				}
-				doneMask |= URI_NORMALIZE_FRAGMENT;
-			}
+			URI_FUNC(FixPercentEncodingInplace)(uri->fragment.first,
+					&(uri->fragment.afterLast), URI_FALSE);
 		}
 	}
 
-	/* Dup all not duped yet */
-	if ((outMask == NULL) && !uri->owner) {
-		if (!URI_FUNC(MakeOwnerEngine)(uri, &doneMask, memory)) {
-			URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-			return URI_ERROR_MALLOC;
-		}
-		uri->owner = URI_TRUE;
+	/* Port, empty path, empty query, fragment */
+	if (!URI_FUNC(NormalizeSchemeBased)(uri, inMask, outMask, memory)) {
+		return URI_ERROR_MALLOC;
 	}
 
 	return URI_SUCCESS;
@@ -797,7 +831,8 @@ static URI_INLINE int URI_FUNC(NormalizeSyntaxEngine)(URI_TYPE(Uri) * uri,
 
 
 int URI_FUNC(MakeOwnerMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
-	unsigned int doneMask = URI_NORMALIZED;
+	URI_TYPE(Uri) copy;
+	int res;
 
 	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
 
@@ -809,12 +844,16 @@ int URI_FUNC(MakeOwnerMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 		return URI_SUCCESS;
 	}
 
-	if (! URI_FUNC(MakeOwnerEngine)(uri, &doneMask, memory)) {
-		URI_FUNC(PreventLeakage)(uri, doneMask, memory);
-		return URI_ERROR_MALLOC;
+	/* Rather than a heap string per component, text, path segment
+	 * nodes and host data all move into a single block */
+	res = URI_FUNC(CopyUriMm)(&copy, uri, memory);
+	if (res != URI_SUCCESS) {
+		return res;
 	}
 
-	uri->owner = URI_TRUE;
+	/* Not owner, so this only releases nodes and host data */
+	URI_FUNC(FreeUriMembersMm)(uri, memory);
+	*uri = copy;
 
 	return URI_SUCCESS;
 }
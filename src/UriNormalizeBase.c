@@ -43,6 +43,17 @@
 
 
 
+const UriSchemeDefaults uriSchemeDefaults[] = {
+	{"http", 80, URI_TRUE},
+	{"https", 443, URI_TRUE},
+	{"ws", 80, URI_TRUE},
+	{"wss", 443, URI_TRUE},
+	{"ftp", 21, URI_FALSE},
+	{NULL, 0, URI_FALSE}
+};
+
+
+
 UriBool uriIsUnreserved(int code) {
 	switch (code) {
 	case L'a': /* ALPHA */
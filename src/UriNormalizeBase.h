@@ -46,6 +46,36 @@
 
 
 
+/* All syntax-based normalization, what (unsigned int)-1 stands for */
+#define URI_NORMALIZE_SYNTAX_BASED  (URI_NORMALIZE_SCHEME \
+		| URI_NORMALIZE_USER_INFO | URI_NORMALIZE_HOST | URI_NORMALIZE_PATH \
+		| URI_NORMALIZE_QUERY | URI_NORMALIZE_FRAGMENT)
+
+/* All flags known, including those beyond syntax-based normalization */
+#define URI_NORMALIZE_KNOWN  (URI_NORMALIZE_SYNTAX_BASED \
+		| URI_NORMALIZE_PORT | URI_NORMALIZE_EMPTY_PATH \
+		| URI_NORMALIZE_EMPTY_QUERY | URI_NORMALIZE_DROP_FRAGMENT)
+
+/* Masks with unknown bits, e.g. (unsigned int)-1 or ~URI_NORMALIZE_FRAGMENT,
+ * predate the scheme-based flags and are limited to syntax-based steps */
+#define URI_NORMALIZE_EFFECTIVE_MASK(mask)  \
+		((((mask) & ~(unsigned int)URI_NORMALIZE_KNOWN) != 0) \
+			? ((mask) & URI_NORMALIZE_SYNTAX_BASED) : (mask))
+
+
+
+/* Scheme-specific knowledge for scheme-based normalization */
+typedef struct UriSchemeDefaultsStruct {
+	const char * name; /* Lowercase */
+	unsigned int defaultPort;
+	UriBool emptyPathIsRoot;
+} UriSchemeDefaults;
+
+/* Terminated by an entry with name NULL */
+extern const UriSchemeDefaults uriSchemeDefaults[];
+
+
+
 UriBool uriIsUnreserved(int code);
 
 
@@ -564,7 +564,7 @@ static URI_INLINE const URI_CHAR * URI_FUNC(ParseIpLit2)(
 	case _UT(':'):
 	case _UT(']'):
 	case URI_SET_HEXDIG:
-		state->uri->hostData.ip6 = memory->malloc(memory, 1 * sizeof(UriIp6)); /* Freed when stopping on parse error */
+		state->uri->hostData.ip6 = uriMallocNode(memory, sizeof(UriIp6), URI_MEMORY_HOST_DATA); /* Freed when stopping on parse error */
 		if (state->uri->hostData.ip6 == NULL) {
 			URI_FUNC(StopMalloc)(state, memory);
 			return NULL;
@@ -1005,14 +1005,14 @@ static URI_INLINE UriBool URI_FUNC(OnExitOwnHost2)(
 	state->uri->hostText.afterLast = first; /* HOST END */
 
 	/* Valid IPv4 or just a regname? */
-	state->uri->hostData.ip4 = memory->malloc(memory, 1 * sizeof(UriIp4)); /* Freed when stopping on parse error */
+	state->uri->hostData.ip4 = uriMallocNode(memory, sizeof(UriIp4), URI_MEMORY_HOST_DATA); /* Freed when stopping on parse error */
 	if (state->uri->hostData.ip4 == NULL) {
 		return URI_FALSE; /* Raises malloc error */
 	}
 	if (URI_FUNC(ParseIpFourAddress)(state->uri->hostData.ip4->data,
 			state->uri->hostText.first, state->uri->hostText.afterLast)) {
 		/* Not IPv4 */
-		memory->free(memory, state->uri->hostData.ip4);
+		uriFreeNode(memory, state->uri->hostData.ip4, sizeof(UriIp4), URI_MEMORY_HOST_DATA);
 		state->uri->hostData.ip4 = NULL;
 	}
 	return URI_TRUE; /* Success */
@@ -1082,14 +1082,14 @@ static URI_INLINE UriBool URI_FUNC(OnExitOwnHostUserInfo)(
 	state->uri->hostText.afterLast = first; /* HOST END */
 
 	/* Valid IPv4 or just a regname? */
-	state->uri->hostData.ip4 = memory->malloc(memory, 1 * sizeof(UriIp4)); /* Freed when stopping on parse error */
+	state->uri->hostData.ip4 = uriMallocNode(memory, sizeof(UriIp4), URI_MEMORY_HOST_DATA); /* Freed when stopping on parse error */
 	if (state->uri->hostData.ip4 == NULL) {
 		return URI_FALSE; /* Raises malloc error */
 	}
 	if (URI_FUNC(ParseIpFourAddress)(state->uri->hostData.ip4->data,
 			state->uri->hostText.first, state->uri->hostText.afterLast)) {
 		/* Not IPv4 */
-		memory->free(memory, state->uri->hostData.ip4);
+		uriFreeNode(memory, state->uri->hostData.ip4, sizeof(UriIp4), URI_MEMORY_HOST_DATA);
 		state->uri->hostData.ip4 = NULL;
 	}
 	return URI_TRUE; /* Success */
@@ -1213,14 +1213,14 @@ static URI_INLINE UriBool URI_FUNC(OnExitOwnPortUserInfo)(
 	state->uri->portText.afterLast = first; /* PORT END */
 
 	/* Valid IPv4 or just a regname? */
-	state->uri->hostData.ip4 = memory->malloc(memory, 1 * sizeof(UriIp4)); /* Freed when stopping on parse error */
+	state->uri->hostData.ip4 = uriMallocNode(memory, sizeof(UriIp4), URI_MEMORY_HOST_DATA); /* Freed when stopping on parse error */
 	if (state->uri->hostData.ip4 == NULL) {
 		return URI_FALSE; /* Raises malloc error */
 	}
 	if (URI_FUNC(ParseIpFourAddress)(state->uri->hostData.ip4->data,
 			state->uri->hostText.first, state->uri->hostText.afterLast)) {
 		/* Not IPv4 */
-		memory->free(memory, state->uri->hostData.ip4);
+		uriFreeNode(memory, state->uri->hostData.ip4, sizeof(UriIp4), URI_MEMORY_HOST_DATA);
 		state->uri->hostData.ip4 = NULL;
 	}
 	return URI_TRUE; /* Success */
@@ -2122,7 +2122,7 @@ static URI_INLINE void URI_FUNC(ResetParserStateExceptUri)(URI_TYPE(ParserState)
 static URI_INLINE UriBool URI_FUNC(PushPathSegment)(
 		URI_TYPE(ParserState) * state, const URI_CHAR * first,
 		const URI_CHAR * afterLast, UriMemoryManager * memory) {
-	URI_TYPE(PathSegment) * segment = memory->calloc(memory, 1, sizeof(URI_TYPE(PathSegment)));
+	URI_TYPE(PathSegment) * segment = uriCallocNode(memory, sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
 	if (segment == NULL) {
 		return URI_FALSE; /* Raises malloc error */
 	}
@@ -2259,16 +2259,24 @@ void URI_FUNC(FreeUriMembers)(URI_TYPE(Uri) * uri) {
 
 
 int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
+	UriBool textInBlock = URI_FALSE;
+
 	if (uri == NULL) {
 		return URI_ERROR_NULL;
 	}
 
 	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
 
+	/* Text may live in a single block rather than in pieces,
+	 * see uriNormalizeSyntaxExMmA */
+	if (uri->reserved != NULL) {
+		textInBlock = URI_TRUE;
+	}
+
 	if (uri->owner) {
 		/* Scheme */
 		if (uri->scheme.first != NULL) {
-			if (uri->scheme.first != uri->scheme.afterLast) {
+			if (!textInBlock && (uri->scheme.first != uri->scheme.afterLast)) {
 				memory->free(memory, (URI_CHAR *)uri->scheme.first);
 			}
 			uri->scheme.first = NULL;
@@ -2277,7 +2285,7 @@ int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 
 		/* User info */
 		if (uri->userInfo.first != NULL) {
-			if (uri->userInfo.first != uri->userInfo.afterLast) {
+			if (!textInBlock && (uri->userInfo.first != uri->userInfo.afterLast)) {
 				memory->free(memory, (URI_CHAR *)uri->userInfo.first);
 			}
 			uri->userInfo.first = NULL;
@@ -2293,7 +2301,7 @@ int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 				uri->hostText.afterLast = NULL;
 			}
 
-			if (uri->hostData.ipFuture.first != uri->hostData.ipFuture.afterLast) {
+			if (!textInBlock && (uri->hostData.ipFuture.first != uri->hostData.ipFuture.afterLast)) {
 				memory->free(memory, (URI_CHAR *)uri->hostData.ipFuture.first);
 			}
 			uri->hostData.ipFuture.first = NULL;
@@ -2302,7 +2310,7 @@ int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 
 		/* Host text (after IPvFuture, see above) */
 		if (uri->hostText.first != NULL) {
-			if (uri->hostText.first != uri->hostText.afterLast) {
+			if (!textInBlock && (uri->hostText.first != uri->hostText.afterLast)) {
 				memory->free(memory, (URI_CHAR *)uri->hostText.first);
 			}
 			uri->hostText.first = NULL;
@@ -2312,19 +2320,23 @@ int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 
 	/* Host data - IPv4 */
 	if (uri->hostData.ip4 != NULL) {
-		memory->free(memory, uri->hostData.ip4);
+		if (!uriBlockContains((UriBlock *)uri->reserved, uri->hostData.ip4)) {
+			uriFreeNode(memory, uri->hostData.ip4, sizeof(UriIp4), URI_MEMORY_HOST_DATA);
+		}
 		uri->hostData.ip4 = NULL;
 	}
 
 	/* Host data - IPv6 */
 	if (uri->hostData.ip6 != NULL) {
-		memory->free(memory, uri->hostData.ip6);
+		if (!uriBlockContains((UriBlock *)uri->reserved, uri->hostData.ip6)) {
+			uriFreeNode(memory, uri->hostData.ip6, sizeof(UriIp6), URI_MEMORY_HOST_DATA);
+		}
 		uri->hostData.ip6 = NULL;
 	}
 
 	/* Port text */
 	if (uri->owner && (uri->portText.first != NULL)) {
-		if (uri->portText.first != uri->portText.afterLast) {
+		if (!textInBlock && (uri->portText.first != uri->portText.afterLast)) {
 			memory->free(memory, (URI_CHAR *)uri->portText.first);
 		}
 		uri->portText.first = NULL;
@@ -2336,11 +2348,11 @@ int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 		URI_TYPE(PathSegment) * segWalk = uri->pathHead;
 		while (segWalk != NULL) {
 			URI_TYPE(PathSegment) * const next = segWalk->next;
-			if (uri->owner && (segWalk->text.first != NULL)
+			if (uri->owner && !textInBlock && (segWalk->text.first != NULL)
 					&& (segWalk->text.first < segWalk->text.afterLast)) {
 				memory->free(memory, (URI_CHAR *)segWalk->text.first);
 			}
-			memory->free(memory, segWalk);
+			URI_FUNC(FreePathSegmentNode)(uri, segWalk, memory);
 			segWalk = next;
 		}
 		uri->pathHead = NULL;
@@ -2350,7 +2362,7 @@ int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 	if (uri->owner) {
 		/* Query */
 		if (uri->query.first != NULL) {
-			if (uri->query.first != uri->query.afterLast) {
+			if (!textInBlock && (uri->query.first != uri->query.afterLast)) {
 				memory->free(memory, (URI_CHAR *)uri->query.first);
 			}
 			uri->query.first = NULL;
@@ -2359,7 +2371,7 @@ int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 
 		/* Fragment */
 		if (uri->fragment.first != NULL) {
-			if (uri->fragment.first != uri->fragment.afterLast) {
+			if (!textInBlock && (uri->fragment.first != uri->fragment.afterLast)) {
 				memory->free(memory, (URI_CHAR *)uri->fragment.first);
 			}
 			uri->fragment.first = NULL;
@@ -2367,6 +2379,12 @@ int URI_FUNC(FreeUriMembersMm)(URI_TYPE(Uri) * uri, UriMemoryManager * memory) {
 		}
 	}
 
+	/* Text block */
+	if (textInBlock) {
+		uriFreeBlock(memory, (UriBlock *)uri->reserved);
+		uri->reserved = NULL;
+	}
+
 	return URI_SUCCESS;
 }
 
@@ -2382,7 +2400,7 @@ UriBool URI_FUNC(_TESTING_ONLY_ParseIpSix)(const URI_CHAR * text) {
 	URI_FUNC(ResetUri)(&uri);
 	parser.uri = &uri;
 	URI_FUNC(ResetParserStateExceptUri)(&parser);
-	parser.uri->hostData.ip6 = memory->malloc(memory, 1 * sizeof(UriIp6));
+	parser.uri->hostData.ip6 = uriMallocNode(memory, sizeof(UriIp6), URI_MEMORY_HOST_DATA);
 	res = URI_FUNC(ParseIPv6address2)(&parser, text, afterIpSix, memory);
 	URI_FUNC(FreeUriMembersMm)(&uri, memory);
 	return res == afterIpSix ? URI_TRUE : URI_FALSE;
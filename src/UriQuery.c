@@ -74,17 +74,37 @@
 
 
 
+/* FNV-1a */
+#ifndef URI_QUERY_HASH_INIT
+# define URI_QUERY_HASH_INIT  2166136261u
+# define URI_QUERY_HASH_STEP(hash, unit) \
+		(((hash) ^ (unsigned int)(unit)) * 16777619u)
+#endif
+
+
+
 static int URI_FUNC(ComposeQueryEngine)(URI_CHAR * dest,
 		const URI_TYPE(QueryList) * queryList,
 		int maxChars, int * charsWritten, int * charsRequired,
 		UriBool spaceToPlus, UriBool normalizeBreaks);
 
+static int URI_FUNC(ComposeQueryRangeListEngine)(URI_CHAR * dest,
+		const URI_TYPE(QueryRangeList) * queryList,
+		int maxChars, int * charsWritten, int * charsRequired,
+		UriBool spaceToPlus, UriBool normalizeBreaks);
+
 static UriBool URI_FUNC(AppendQueryItem)(URI_TYPE(QueryList) ** prevNext,
 		int * itemCount, const URI_CHAR * keyFirst, const URI_CHAR * keyAfter,
 		const URI_CHAR * valueFirst, const URI_CHAR * valueAfter,
 		UriBool plusToSpace, UriBreakConversion breakConversion,
 		UriMemoryManager * memory);
 
+static URI_CHAR URI_FUNC(QueryKeyNextUnit)(const URI_CHAR ** walk,
+		const URI_CHAR * afterLast, UriBool plusToSpace);
+static UriBool URI_FUNC(QueryKeyEquals)(const URI_TYPE(TextRange) * rawKey,
+		const URI_CHAR * key, const URI_CHAR * keyAfterLast,
+		UriBool plusToSpace);
+
 
 
 int URI_FUNC(ComposeQueryCharsRequired)(const URI_TYPE(QueryList) * queryList,
@@ -203,85 +223,228 @@ int URI_FUNC(ComposeQueryMallocExMm)(URI_CHAR ** dest,
 
 
 
+int URI_FUNC(ComposeQueryRangeListCharsRequiredEx)(
+		const URI_TYPE(QueryRangeList) * queryList,
+		int * charsRequired, UriBool spaceToPlus, UriBool normalizeBreaks) {
+	if ((queryList == NULL) || (charsRequired == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	return URI_FUNC(ComposeQueryRangeListEngine)(NULL, queryList, 0, NULL,
+			charsRequired, spaceToPlus, normalizeBreaks);
+}
+
+
+
+int URI_FUNC(ComposeQueryRangeListEx)(URI_CHAR * dest,
+		const URI_TYPE(QueryRangeList) * queryList, int maxChars,
+		int * charsWritten, UriBool spaceToPlus, UriBool normalizeBreaks) {
+	if ((dest == NULL) || (queryList == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (maxChars < 1) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	return URI_FUNC(ComposeQueryRangeListEngine)(dest, queryList, maxChars,
+			charsWritten, NULL, spaceToPlus, normalizeBreaks);
+}
+
+
+
+int URI_FUNC(ComposeQueryRangeListMallocEx)(URI_CHAR ** dest,
+		const URI_TYPE(QueryRangeList) * queryList,
+		UriBool spaceToPlus, UriBool normalizeBreaks) {
+	return URI_FUNC(ComposeQueryRangeListMallocExMm)(dest, queryList,
+			spaceToPlus, normalizeBreaks, NULL);
+}
+
+
+
+int URI_FUNC(ComposeQueryRangeListMallocExMm)(URI_CHAR ** dest,
+		const URI_TYPE(QueryRangeList) * queryList,
+		UriBool spaceToPlus, UriBool normalizeBreaks,
+		UriMemoryManager * memory) {
+	int charsRequired;
+	int res;
+	URI_CHAR * queryString;
+
+	if (dest == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	/* Calculate space */
+	res = URI_FUNC(ComposeQueryRangeListCharsRequiredEx)(queryList,
+			&charsRequired, spaceToPlus, normalizeBreaks);
+	if (res != URI_SUCCESS) {
+		return res;
+	}
+	if (charsRequired == INT_MAX) {
+		return URI_ERROR_MALLOC;
+	}
+	charsRequired++;
+
+	/* Allocate space */
+	queryString = memory->malloc(memory, charsRequired * sizeof(URI_CHAR));
+	if (queryString == NULL) {
+		return URI_ERROR_MALLOC;
+	}
+
+	/* Put query in */
+	res = URI_FUNC(ComposeQueryRangeListEx)(queryString, queryList,
+			charsRequired, NULL, spaceToPlus, normalizeBreaks);
+	if (res != URI_SUCCESS) {
+		memory->free(memory, queryString);
+		return res;
+	}
+
+	*dest = queryString;
+	return URI_SUCCESS;
+}
+
+
+
+/* Accounts for a single "key[=value]" item preceded by '&' unless first
+ * and writes it unless dest is NULL.  An afterLast of NULL means that
+ * the key or value is terminated, a valueFirst of NULL means no value. */
+static int URI_FUNC(ComposeQueryItem)(URI_CHAR * dest, URI_CHAR ** write,
+		int maxChars, int * totalChars, UriBool firstItem,
+		const URI_CHAR * keyFirst, const URI_CHAR * keyAfterLast,
+		const URI_CHAR * valueFirst, const URI_CHAR * valueAfterLast,
+		UriBool spaceToPlus, UriBool normalizeBreaks) {
+	const size_t ampersandLen = (firstItem == URI_TRUE) ? 0 : 1;
+	const size_t keyRequiredChars = URI_FUNC(EscapedLength)(keyFirst,
+			keyAfterLast, spaceToPlus, normalizeBreaks);
+	const size_t valueRequiredChars = URI_FUNC(EscapedLength)(valueFirst,
+			valueAfterLast, spaceToPlus, normalizeBreaks);
+	const size_t itemRequiredChars = ampersandLen + keyRequiredChars
+			+ ((valueFirst == NULL) ? 0 : 1 + valueRequiredChars);
+
+	if ((keyRequiredChars >= (size_t)INT_MAX)
+			|| (valueRequiredChars >= (size_t)INT_MAX)
+			|| (itemRequiredChars > (size_t)INT_MAX - (size_t)*totalChars)) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+	*totalChars += (int)itemRequiredChars;
+
+	if (dest == NULL) {
+		return URI_SUCCESS;
+	}
+
+	if (*totalChars > maxChars) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	/* Copy key */
+	if (ampersandLen == 1) {
+		(*write)[0] = _UT('&');
+		(*write)++;
+	}
+	*write = URI_FUNC(EscapeEx)(keyFirst, keyAfterLast,
+			*write, spaceToPlus, normalizeBreaks);
+
+	if (valueFirst != NULL) {
+		/* Copy value */
+		(*write)[0] = _UT('=');
+		(*write)++;
+		*write = URI_FUNC(EscapeEx)(valueFirst, valueAfterLast,
+				*write, spaceToPlus, normalizeBreaks);
+	}
+
+	return URI_SUCCESS;
+}
+
+
+
+/* Stores the result of a compose run to wherever the caller wants it */
+static int URI_FUNC(ComposeQueryFinish)(URI_CHAR * dest, URI_CHAR * write,
+		int totalChars, int * charsWritten, int * charsRequired) {
+	if (dest == NULL) {
+		*charsRequired = totalChars;
+	} else {
+		write[0] = _UT('\0');
+		if (charsWritten != NULL) {
+			*charsWritten = (int)(write - dest) + 1; /* .. for terminator */
+		}
+	}
+
+	return URI_SUCCESS;
+}
+
+
+
 int URI_FUNC(ComposeQueryEngine)(URI_CHAR * dest,
 		const URI_TYPE(QueryList) * queryList,
 		int maxChars, int * charsWritten, int * charsRequired,
 		UriBool spaceToPlus, UriBool normalizeBreaks) {
 	UriBool firstItem = URI_TRUE;
-	int ampersandLen = 0;  /* increased to 1 from second item on */
+	int totalChars = 0;  /* excluding terminator */
 	URI_CHAR * write = dest;
 
 	/* Subtract terminator */
-	if (dest == NULL) {
-		*charsRequired = 0;
-	} else {
+	if (dest != NULL) {
 		maxChars--;
 	}
 
 	while (queryList != NULL) {
-		const URI_CHAR * const key = queryList->key;
-		const URI_CHAR * const value = queryList->value;
-		const int worstCase = (normalizeBreaks == URI_TRUE ? 6 : 3);
-		const size_t keyLen = (key == NULL) ? 0 : URI_STRLEN(key);
-		int keyRequiredChars;
-		const size_t valueLen = (value == NULL) ? 0 : URI_STRLEN(value);
-		int valueRequiredChars;
-
-		if ((keyLen >= (size_t)INT_MAX / worstCase) || (valueLen >= (size_t)INT_MAX / worstCase)) {
-			return URI_ERROR_OUTPUT_TOO_LARGE;
+		const int res = URI_FUNC(ComposeQueryItem)(dest, &write, maxChars,
+				&totalChars, firstItem, queryList->key, NULL,
+				queryList->value, NULL, spaceToPlus, normalizeBreaks);
+		if (res != URI_SUCCESS) {
+			return res;
 		}
-		keyRequiredChars = worstCase * (int)keyLen;
-		valueRequiredChars = worstCase * (int)valueLen;
 
-		if (dest == NULL) {
-			(*charsRequired) += ampersandLen + keyRequiredChars + ((value == NULL)
-						? 0
-						: 1 + valueRequiredChars);
+		firstItem = URI_FALSE;
+		queryList = queryList->next;
+	}
 
-			if (firstItem == URI_TRUE) {
-				ampersandLen = 1;
-				firstItem = URI_FALSE;
-			}
-		} else {
-			if ((write - dest) + ampersandLen + keyRequiredChars > maxChars) {
-				return URI_ERROR_OUTPUT_TOO_LARGE;
-			}
+	return URI_FUNC(ComposeQueryFinish)(dest, write, totalChars,
+			charsWritten, charsRequired);
+}
 
-			/* Copy key */
-			if (firstItem == URI_TRUE) {
-				ampersandLen = 1;
-				firstItem = URI_FALSE;
-			} else {
-				write[0] = _UT('&');
-				write++;
-			}
-			write = URI_FUNC(EscapeEx)(key, key + keyLen,
-					write, spaceToPlus, normalizeBreaks);
 
-			if (value != NULL) {
-				if ((write - dest) + 1 + valueRequiredChars > maxChars) {
-					return URI_ERROR_OUTPUT_TOO_LARGE;
-				}
 
-				/* Copy value */
-				write[0] = _UT('=');
-				write++;
-				write = URI_FUNC(EscapeEx)(value, value + valueLen,
-						write, spaceToPlus, normalizeBreaks);
-			}
-		}
+int URI_FUNC(ComposeQueryRangeListEngine)(URI_CHAR * dest,
+		const URI_TYPE(QueryRangeList) * queryList,
+		int maxChars, int * charsWritten, int * charsRequired,
+		UriBool spaceToPlus, UriBool normalizeBreaks) {
+	UriBool firstItem = URI_TRUE;
+	int totalChars = 0;  /* excluding terminator */
+	URI_CHAR * write = dest;
 
-		queryList = queryList->next;
+	/* Subtract terminator */
+	if (dest != NULL) {
+		maxChars--;
 	}
 
-	if (dest != NULL) {
-		write[0] = _UT('\0');
-		if (charsWritten != NULL) {
-			*charsWritten = (int)(write - dest) + 1; /* .. for terminator */
+	while (queryList != NULL) {
+		const URI_TYPE(TextRange) * const key = &(queryList->key);
+		const URI_TYPE(TextRange) * const value = &(queryList->value);
+		int res;
+
+		if ((key->first > key->afterLast)
+				|| ((key->first != NULL) && (key->afterLast == NULL))
+				|| (value->first > value->afterLast)
+				|| ((value->first != NULL) && (value->afterLast == NULL))) {
+			return URI_ERROR_RANGE_INVALID;
+		}
+
+		res = URI_FUNC(ComposeQueryItem)(dest, &write, maxChars,
+				&totalChars, firstItem, key->first, key->afterLast,
+				value->first, value->afterLast, spaceToPlus, normalizeBreaks);
+		if (res != URI_SUCCESS) {
+			return res;
 		}
+
+		firstItem = URI_FALSE;
+		queryList = queryList->next;
 	}
 
-	return URI_SUCCESS;
+	return URI_FUNC(ComposeQueryFinish)(dest, write, totalChars,
+			charsWritten, charsRequired);
 }
 
 
@@ -305,7 +468,7 @@ UriBool URI_FUNC(AppendQueryItem)(URI_TYPE(QueryList) ** prevNext,
 	}
 
 	/* Append new empty item */
-	*prevNext = memory->malloc(memory, 1 * sizeof(URI_TYPE(QueryList)));
+	*prevNext = uriMallocNode(memory, sizeof(URI_TYPE(QueryList)), URI_MEMORY_QUERY_LIST);
 	if (*prevNext == NULL) {
 		return URI_FALSE; /* Raises malloc error */
 	}
@@ -313,9 +476,9 @@ UriBool URI_FUNC(AppendQueryItem)(URI_TYPE(QueryList) ** prevNext,
 
 
 	/* Fill key */
-	key = memory->malloc(memory, (keyLen + 1) * sizeof(URI_CHAR));
+	key = uriMallocKind(memory, (keyLen + 1) * sizeof(URI_CHAR), URI_MEMORY_TEXT);
 	if (key == NULL) {
-		memory->free(memory, *prevNext);
+		uriFreeNode(memory, *prevNext, sizeof(URI_TYPE(QueryList)), URI_MEMORY_QUERY_LIST);
 		*prevNext = NULL;
 		return URI_FALSE; /* Raises malloc error */
 	}
@@ -333,10 +496,10 @@ UriBool URI_FUNC(AppendQueryItem)(URI_TYPE(QueryList) ** prevNext,
 
 	/* Fill value */
 	if (valueFirst != NULL) {
-		value = memory->malloc(memory, (valueLen + 1) * sizeof(URI_CHAR));
+		value = uriMallocKind(memory, (valueLen + 1) * sizeof(URI_CHAR), URI_MEMORY_TEXT);
 		if (value == NULL) {
 			memory->free(memory, key);
-			memory->free(memory, *prevNext);
+			uriFreeNode(memory, *prevNext, sizeof(URI_TYPE(QueryList)), URI_MEMORY_QUERY_LIST);
 			*prevNext = NULL;
 			return URI_FALSE; /* Raises malloc error */
 		}
@@ -374,7 +537,7 @@ int URI_FUNC(FreeQueryListMm)(URI_TYPE(QueryList) * queryList,
 		URI_TYPE(QueryList) * nextBackup = queryList->next;
 		memory->free(memory, (URI_CHAR *)queryList->key); /* const cast */
 		memory->free(memory, (URI_CHAR *)queryList->value); /* const cast */
-		memory->free(memory, queryList);
+		uriFreeNode(memory, queryList, sizeof(URI_TYPE(QueryList)), URI_MEMORY_QUERY_LIST);
 		queryList = nextBackup;
 	}
 	return URI_SUCCESS;
@@ -406,11 +569,9 @@ int URI_FUNC(DissectQueryMallocExMm)(URI_TYPE(QueryList) ** dest, int * itemCoun
 		const URI_CHAR * first, const URI_CHAR * afterLast,
 		UriBool plusToSpace, UriBreakConversion breakConversion,
 		UriMemoryManager * memory) {
-	const URI_CHAR * walk = first;
-	const URI_CHAR * keyFirst = first;
-	const URI_CHAR * keyAfter = NULL;
-	const URI_CHAR * valueFirst = NULL;
-	const URI_CHAR * valueAfter = NULL;
+	URI_TYPE(QueryIterator) iterator;
+	URI_TYPE(TextRange) key;
+	URI_TYPE(TextRange) value;
 	URI_TYPE(QueryList) ** prevNext = dest;
 	int nullCounter;
 	int * itemsAppended = (itemCount == NULL) ? &nullCounter : itemCount;
@@ -428,50 +589,191 @@ int URI_FUNC(DissectQueryMallocExMm)(URI_TYPE(QueryList) ** dest, int * itemCoun
 	*dest = NULL;
 	*itemsAppended = 0;
 
-	/* Parse query string */
-	for (; walk < afterLast; walk++) {
-		switch (*walk) {
-		case _UT('&'):
-			if (valueFirst != NULL) {
-				valueAfter = walk;
-			} else {
-				keyAfter = walk;
-			}
+	URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast);
+	while (URI_FUNC(QueryIteratorNext)(&iterator, &key, &value, NULL)) {
+		if (URI_FUNC(AppendQueryItem)(prevNext, itemsAppended,
+				key.first, key.afterLast, value.first, value.afterLast,
+				plusToSpace, breakConversion, memory)
+				== URI_FALSE) {
+			/* Free list we built */
+			*itemsAppended = 0;
+			URI_FUNC(FreeQueryListMm)(*dest, memory);
+			return URI_ERROR_MALLOC;
+		}
 
-			if (URI_FUNC(AppendQueryItem)(prevNext, itemsAppended,
-					keyFirst, keyAfter, valueFirst, valueAfter,
-					plusToSpace, breakConversion, memory)
-					== URI_FALSE) {
-				/* Free list we built */
-				*itemsAppended = 0;
-				URI_FUNC(FreeQueryListMm)(*dest, memory);
-				return URI_ERROR_MALLOC;
-			}
+		/* Make future items children of the current */
+		prevNext = &((*prevNext)->next);
+	}
 
-			/* Make future items children of the current */
-			if ((prevNext != NULL) && (*prevNext != NULL)) {
-				prevNext = &((*prevNext)->next);
-			}
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(DissectQueryArrayMallocEx)(URI_TYPE(QueryList) ** dest,
+		int * itemCount, const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion) {
+	return URI_FUNC(DissectQueryArrayMallocExMm)(dest, itemCount, first,
+			afterLast, plusToSpace, breakConversion, NULL);
+}
+
+
+
+/* Counts the items of a query and the characters needed to hold
+ * their keys and values including terminators */
+static void URI_FUNC(QuerySizeItems)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, size_t * itemsTotal, size_t * charsTotal) {
+	URI_TYPE(QueryIterator) iterator;
+	URI_TYPE(TextRange) key;
+	URI_TYPE(TextRange) value;
+
+	*itemsTotal = 0;
+	*charsTotal = 0;
+
+	URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast);
+	while (URI_FUNC(QueryIteratorNext)(&iterator, &key, &value, NULL)) {
+		(*itemsTotal)++;
+		*charsTotal += (size_t)(key.afterLast - key.first) + 1;
+		if (value.first != NULL) {
+			*charsTotal += (size_t)(value.afterLast - value.first) + 1;
+		}
+	}
+}
+
+
+
+/* Fills an array of items sized by QuerySizeItems, linking them
+ * through next, with unescaped keys and values written to text */
+static void URI_FUNC(QueryFillItems)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, URI_TYPE(QueryList) * items,
+		int * keyLengths, size_t itemsTotal, URI_CHAR * text,
+		UriBool plusToSpace, UriBreakConversion breakConversion) {
+	URI_TYPE(QueryIterator) iterator;
+	URI_TYPE(TextRange) key;
+	URI_TYPE(TextRange) value;
+	size_t index = 0;
+
+	URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast);
+	while (URI_FUNC(QueryIteratorNext)(&iterator, &key, &value, NULL)) {
+		const size_t keyLen = (size_t)(key.afterLast - key.first);
+		const URI_CHAR * keyAfterLast;
+
+		memcpy(text, key.first, keyLen * sizeof(URI_CHAR));
+		text[keyLen] = _UT('\0');
+		keyAfterLast = URI_FUNC(UnescapeInPlaceEx)(text, plusToSpace,
+				breakConversion);
+		if (keyLengths != NULL) {
+			/* The unescaped key may contain NUL characters */
+			keyLengths[index] = (int)(keyAfterLast - text);
+		}
+		items[index].key = text;
+		text += keyLen + 1;
+
+		if (value.first != NULL) {
+			const size_t valueLen = (size_t)(value.afterLast - value.first);
+
+			memcpy(text, value.first, valueLen * sizeof(URI_CHAR));
+			text[valueLen] = _UT('\0');
+			URI_FUNC(UnescapeInPlaceEx)(text, plusToSpace, breakConversion);
+			items[index].value = text;
+			text += valueLen + 1;
+		} else {
+			items[index].value = NULL;
+		}
+
+		items[index].next = (index + 1 < itemsTotal) ? items + index + 1 : NULL;
+		index++;
+	}
+}
+
+
+
+int URI_FUNC(DissectQueryArrayMallocExMm)(URI_TYPE(QueryList) ** dest,
+		int * itemCount, const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriMemoryManager * memory) {
+	URI_TYPE(QueryList) * items;
+	size_t itemsTotal;
+	size_t charsTotal;
+
+	if ((dest == NULL) || (first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	*dest = NULL;
+	if (itemCount != NULL) {
+		*itemCount = 0;
+	}
+
+	URI_FUNC(QuerySizeItems)(first, afterLast, &itemsTotal, &charsTotal);
+	if (itemsTotal == 0) {
+		return URI_SUCCESS;
+	}
+
+	if ((itemsTotal > (size_t)INT_MAX)
+			|| (charsTotal > ((size_t)-1) / sizeof(URI_CHAR))
+			|| (itemsTotal > (((size_t)-1) - charsTotal * sizeof(URI_CHAR))
+				/ sizeof(URI_TYPE(QueryList)))) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	items = memory->malloc(memory, itemsTotal * sizeof(URI_TYPE(QueryList))
+			+ charsTotal * sizeof(URI_CHAR));
+	if (items == NULL) {
+		return URI_ERROR_MALLOC;
+	}
+
+	URI_FUNC(QueryFillItems)(first, afterLast, items, NULL, itemsTotal,
+			(URI_CHAR *)(items + itemsTotal), plusToSpace, breakConversion);
+
+	*dest = items;
+	if (itemCount != NULL) {
+		*itemCount = (int)itemsTotal;
+	}
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(DissectQueryRangeListMallocEx)(
+		URI_TYPE(QueryRangeList) ** dest,
+		int * itemCount, const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion) {
+	return URI_FUNC(DissectQueryRangeListMallocExMm)(dest, itemCount, first,
+			afterLast, plusToSpace, breakConversion, NULL);
+}
+
+
+
+/* Tells whether uriUnescapeInPlaceEx(A|W) would produce
+ * anything other than a plain copy of the given range */
+static UriBool URI_FUNC(QueryRangeNeedsUnescape)(
+		const URI_TYPE(TextRange) * range,
+		UriBool plusToSpace, UriBreakConversion breakConversion) {
+	const URI_CHAR * walk = range->first;
+
+	for (; walk < range->afterLast; walk++) {
+		switch (*walk) {
+		case _UT('%'):
+		case _UT('\0'):
+			return URI_TRUE;
 
-			if (walk + 1 < afterLast) {
-				keyFirst = walk + 1;
-			} else {
-				keyFirst = NULL;
+		case _UT('+'):
+			if (plusToSpace == URI_TRUE) {
+				return URI_TRUE;
 			}
-			keyAfter = NULL;
-			valueFirst = NULL;
-			valueAfter = NULL;
 			break;
 
-		case _UT('='):
-			/* NOTE: WE treat the first '=' as a separator, */
-			/*       all following go into the value part   */
-			if (keyAfter == NULL) {
-				keyAfter = walk;
-				if (walk + 1 <= afterLast) {
-					valueFirst = walk + 1;
-					valueAfter = walk + 1;
-				}
+		case _UT('\x0a'):
+		case _UT('\x0d'):
+			if (breakConversion != URI_BR_DONT_TOUCH) {
+				return URI_TRUE;
 			}
 			break;
 
@@ -480,26 +782,1280 @@ int URI_FUNC(DissectQueryMallocExMm)(URI_TYPE(QueryList) ** dest, int * itemCoun
 		}
 	}
 
-	if (valueFirst != NULL) {
-		/* Must be key/value pair */
-		valueAfter = walk;
-	} else {
-		/* Must be key only */
-		keyAfter = walk;
+	return URI_FALSE;
+}
+
+
+
+/* Points range into the source if possible, otherwise unescapes it
+ * into text (unless NULL) and returns the number of characters used */
+static size_t URI_FUNC(QueryRangeResolve)(URI_TYPE(TextRange) * range,
+		URI_CHAR * text, UriBool plusToSpace,
+		UriBreakConversion breakConversion) {
+	size_t len;
+
+	if (! URI_FUNC(QueryRangeNeedsUnescape)(range, plusToSpace,
+			breakConversion)) {
+		return 0;
+	}
+
+	len = (size_t)(range->afterLast - range->first);
+	if (text != NULL) {
+		memcpy(text, range->first, len * sizeof(URI_CHAR));
+		text[len] = _UT('\0');
+		range->first = text;
+		range->afterLast = URI_FUNC(UnescapeInPlaceEx)(text, plusToSpace,
+				breakConversion);
+	}
+	return len + 1;
+}
+
+
+
+int URI_FUNC(DissectQueryRangeListMallocExMm)(
+		URI_TYPE(QueryRangeList) ** dest,
+		int * itemCount, const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriMemoryManager * memory) {
+	URI_TYPE(QueryIterator) iterator;
+	URI_TYPE(QueryRangeList) item;
+	URI_TYPE(QueryRangeList) * items;
+	URI_CHAR * text;
+	size_t itemsTotal = 0;
+	size_t charsTotal = 0;
+	size_t index = 0;
+
+	if ((dest == NULL) || (first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	*dest = NULL;
+	if (itemCount != NULL) {
+		*itemCount = 0;
+	}
+
+	/* Count items and the characters needed for those to unescape */
+	URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast);
+	while (URI_FUNC(QueryIteratorNext)(&iterator, &item.key, &item.value,
+			NULL)) {
+		itemsTotal++;
+		charsTotal += URI_FUNC(QueryRangeResolve)(&item.key, NULL,
+				plusToSpace, breakConversion);
+		charsTotal += URI_FUNC(QueryRangeResolve)(&item.value, NULL,
+				plusToSpace, breakConversion);
+	}
+	if (itemsTotal == 0) {
+		return URI_SUCCESS;
+	}
+
+	if ((itemsTotal > (size_t)INT_MAX)
+			|| (charsTotal > ((size_t)-1) / sizeof(URI_CHAR))
+			|| (itemsTotal > (((size_t)-1) - charsTotal * sizeof(URI_CHAR))
+				/ sizeof(URI_TYPE(QueryRangeList)))) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
 	}
 
-	if (URI_FUNC(AppendQueryItem)(prevNext, itemsAppended, keyFirst, keyAfter,
-			valueFirst, valueAfter, plusToSpace, breakConversion, memory)
-			== URI_FALSE) {
-		/* Free list we built */
-		*itemsAppended = 0;
-		URI_FUNC(FreeQueryListMm)(*dest, memory);
+	items = memory->malloc(memory, itemsTotal * sizeof(URI_TYPE(QueryRangeList))
+			+ charsTotal * sizeof(URI_CHAR));
+	if (items == NULL) {
 		return URI_ERROR_MALLOC;
 	}
 
+	/* Fill items */
+	text = (URI_CHAR *)(items + itemsTotal);
+	URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast);
+	while (URI_FUNC(QueryIteratorNext)(&iterator, &items[index].key,
+			&items[index].value, NULL)) {
+		text += URI_FUNC(QueryRangeResolve)(&items[index].key, text,
+				plusToSpace, breakConversion);
+		text += URI_FUNC(QueryRangeResolve)(&items[index].value, text,
+				plusToSpace, breakConversion);
+		items[index].next = (index + 1 < itemsTotal) ? items + index + 1 : NULL;
+		index++;
+	}
+
+	*dest = items;
+	if (itemCount != NULL) {
+		*itemCount = (int)itemsTotal;
+	}
 	return URI_SUCCESS;
 }
 
 
 
+int URI_FUNC(QueryMapMallocEx)(URI_TYPE(QueryMap) ** dest,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion) {
+	return URI_FUNC(QueryMapMallocExMm)(dest, first, afterLast,
+			plusToSpace, breakConversion, NULL);
+}
+
+
+
+static unsigned int URI_FUNC(QueryHashKey)(const URI_CHAR * key,
+		int keyLen) {
+	const URI_CHAR * const keyAfterLast = key + keyLen;
+	unsigned int hash = URI_QUERY_HASH_INIT;
+	for (; key < keyAfterLast; key++) {
+		hash = URI_QUERY_HASH_STEP(hash, *key);
+	}
+	return hash;
+}
+
+
+
+/* Compares a key of the map by length rather than up to NUL,
+ * so that "a%00b" does not match "a" */
+static URI_INLINE UriBool URI_FUNC(QueryMapKeyEquals)(
+		const URI_TYPE(QueryMap) * map, int index, unsigned int hash,
+		const URI_CHAR * key, int keyLen) {
+	return ((map->hashes[index] == hash)
+			&& (map->keyLengths[index] == keyLen)
+			&& !memcmp(map->items[index].key, key, keyLen * sizeof(URI_CHAR)))
+			? URI_TRUE : URI_FALSE;
+}
+
+
+
+int URI_FUNC(QueryMapMallocExMm)(URI_TYPE(QueryMap) ** dest,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriMemoryManager * memory) {
+	URI_TYPE(QueryMap) * map;
+	size_t itemsTotal;
+	size_t charsTotal;
+	size_t slotsTotal = 1;
+	size_t perItemBytes;
+	size_t index;
+
+	if ((dest == NULL) || (first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	*dest = NULL;
+
+	URI_FUNC(QuerySizeItems)(first, afterLast, &itemsTotal, &charsTotal);
+
+	/* Keep the table at most half full */
+	if (itemsTotal > (size_t)INT_MAX / 4) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+	while (slotsTotal < 2 * itemsTotal) {
+		slotsTotal *= 2;
+	}
+
+	perItemBytes = sizeof(URI_TYPE(QueryList)) + sizeof(unsigned int)
+			+ 2 * sizeof(int);
+	if ((charsTotal > ((size_t)-1) / sizeof(URI_CHAR))
+			|| (itemsTotal > (((size_t)-1) - sizeof(URI_TYPE(QueryMap))
+				- slotsTotal * sizeof(int) - charsTotal * sizeof(URI_CHAR))
+				/ perItemBytes)) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	/* Layout: map, items, hashes, sameKeyNext, keyLengths, slots, text */
+	map = memory->malloc(memory, sizeof(URI_TYPE(QueryMap))
+			+ itemsTotal * perItemBytes + slotsTotal * sizeof(int)
+			+ charsTotal * sizeof(URI_CHAR));
+	if (map == NULL) {
+		return URI_ERROR_MALLOC;
+	}
+	map->items = (URI_TYPE(QueryList) *)(map + 1);
+	map->itemCount = (int)itemsTotal;
+	map->hashes = (unsigned int *)(map->items + itemsTotal);
+	map->sameKeyNext = (int *)(map->hashes + itemsTotal);
+	map->keyLengths = map->sameKeyNext + itemsTotal;
+	map->slots = map->keyLengths + itemsTotal;
+	map->slotCount = (int)slotsTotal;
+
+	URI_FUNC(QueryFillItems)(first, afterLast, map->items, map->keyLengths,
+			itemsTotal, (URI_CHAR *)(map->slots + slotsTotal),
+			plusToSpace, breakConversion);
+
+	/* Index back to front so that prepending keeps query order */
+	memset(map->slots, 0, slotsTotal * sizeof(int));
+	for (index = itemsTotal; index > 0; index--) {
+		const size_t itemIndex = index - 1;
+		const URI_CHAR * const key = map->items[itemIndex].key;
+		const int keyLen = map->keyLengths[itemIndex];
+		const unsigned int hash = URI_FUNC(QueryHashKey)(key, keyLen);
+		size_t slot = hash & (slotsTotal - 1);
+
+		map->hashes[itemIndex] = hash;
+		map->sameKeyNext[itemIndex] = 0;
+
+		while (map->slots[slot] != 0) {
+			const int candidate = map->slots[slot] - 1;
+			if (URI_FUNC(QueryMapKeyEquals)(map, candidate, hash, key, keyLen)) {
+				map->sameKeyNext[itemIndex] = candidate + 1;
+				break;
+			}
+			slot = (slot + 1) & (slotsTotal - 1);
+		}
+		map->slots[slot] = (int)itemIndex + 1;
+	}
+
+	*dest = map;
+	return URI_SUCCESS;
+}
+
+
+
+const URI_TYPE(QueryList) * URI_FUNC(QueryMapFind)(
+		const URI_TYPE(QueryMap) * map, const URI_CHAR * key) {
+	unsigned int hash;
+	size_t slot;
+	size_t keyLen;
+
+	if ((map == NULL) || (key == NULL)) {
+		return NULL;
+	}
+
+	keyLen = URI_STRLEN(key);
+	if (keyLen > (size_t)INT_MAX) {
+		return NULL;
+	}
+	hash = URI_FUNC(QueryHashKey)(key, (int)keyLen);
+	slot = hash & ((size_t)map->slotCount - 1);
+	while (map->slots[slot] != 0) {
+		const int candidate = map->slots[slot] - 1;
+		if (URI_FUNC(QueryMapKeyEquals)(map, candidate, hash, key, (int)keyLen)) {
+			return map->items + candidate;
+		}
+		slot = (slot + 1) & ((size_t)map->slotCount - 1);
+	}
+
+	return NULL;
+}
+
+
+
+const URI_TYPE(QueryList) * URI_FUNC(QueryMapFindNext)(
+		const URI_TYPE(QueryMap) * map, const URI_TYPE(QueryList) * item) {
+	int next;
+
+	if ((map == NULL) || (item == NULL)) {
+		return NULL;
+	}
+
+	next = map->sameKeyNext[item - map->items];
+	return (next == 0) ? NULL : map->items + next - 1;
+}
+
+
+
+/* Tells whether the unescaped version of a raw key matches a pattern,
+ * a trailing '*' of the pattern matches any remainder */
+static UriBool URI_FUNC(QueryKeyMatches)(const URI_TYPE(TextRange) * rawKey,
+		const URI_CHAR * pattern, UriBool plusToSpace) {
+	const URI_CHAR * patternAfterLast = pattern + URI_STRLEN(pattern);
+	const URI_CHAR * walk = rawKey->first;
+	UriBool prefix = URI_FALSE;
+
+	if ((patternAfterLast > pattern) && (patternAfterLast[-1] == _UT('*'))) {
+		patternAfterLast--;
+		prefix = URI_TRUE;
+	}
+
+	while (walk < rawKey->afterLast) {
+		if (pattern >= patternAfterLast) {
+			return prefix;
+		}
+		if (URI_FUNC(QueryKeyNextUnit)(&walk, rawKey->afterLast,
+				plusToSpace) != *pattern) {
+			return URI_FALSE;
+		}
+		pattern++;
+	}
+
+	return (pattern == patternAfterLast) ? URI_TRUE : URI_FALSE;
+}
+
+
+
+int URI_FUNC(FilterQuery)(URI_CHAR * dest,
+		URI_CHAR ** destAfterLast,
+		const URI_CHAR * first, const URI_CHAR * afterLast,
+		const URI_CHAR * const * patterns, int patternCount,
+		UriBool plusToSpace) {
+	URI_TYPE(QueryIterator) iterator;
+	URI_TYPE(TextRange) key;
+	URI_TYPE(TextRange) value;
+	URI_CHAR * write = dest;
+	int i;
+
+	if ((dest == NULL) || (destAfterLast == NULL) || (first == NULL)
+			|| (afterLast == NULL)
+			|| ((patterns == NULL) && (patternCount > 0))) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	for (i = 0; i < patternCount; i++) {
+		if (patterns[i] == NULL) {
+			return URI_ERROR_NULL;
+		}
+	}
+
+	/* NOTE: When filtering in place, write never passes the
+	 *       item being read as items only ever get dropped */
+	URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast);
+	while (URI_FUNC(QueryIteratorNext)(&iterator, &key, &value, NULL)) {
+		const URI_CHAR * const itemAfterLast
+				= (value.first != NULL) ? value.afterLast : key.afterLast;
+		UriBool drop = URI_FALSE;
+
+		for (i = 0; i < patternCount; i++) {
+			if (URI_FUNC(QueryKeyMatches)(&key, patterns[i], plusToSpace)) {
+				drop = URI_TRUE;
+				break;
+			}
+		}
+		if (drop) {
+			continue;
+		}
+
+		if (write != dest) {
+			write[0] = _UT('&');
+			write++;
+		}
+		memmove(write, key.first,
+				(size_t)(itemAfterLast - key.first) * sizeof(URI_CHAR));
+		write += itemAfterLast - key.first;
+	}
+
+	*destAfterLast = write;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(FilterUriQuery)(URI_TYPE(Uri) * uri,
+		const URI_CHAR * const * patterns, int patternCount,
+		UriBool plusToSpace) {
+	return URI_FUNC(FilterUriQueryMm)(uri, patterns, patternCount,
+			plusToSpace, NULL);
+}
+
+
+
+int URI_FUNC(FilterUriQueryMm)(URI_TYPE(Uri) * uri,
+		const URI_CHAR * const * patterns, int patternCount,
+		UriBool plusToSpace, UriMemoryManager * memory) {
+	URI_CHAR * queryAfterLast;
+	int res;
+
+	if (uri == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	if (uri->query.first == NULL) {
+		return URI_SUCCESS;
+	}
+
+	res = URI_FUNC(MakeOwnerMm)(uri, memory);
+	if (res != URI_SUCCESS) {
+		return res;
+	}
+
+	if (uri->query.first == uri->query.afterLast) {
+		return URI_SUCCESS;
+	}
+
+	res = URI_FUNC(FilterQuery)((URI_CHAR *)uri->query.first, &queryAfterLast,
+			uri->query.first, uri->query.afterLast, patterns, patternCount,
+			plusToSpace);
+	if (res != URI_SUCCESS) {
+		return res;
+	}
+
+	if (queryAfterLast == uri->query.first) {
+		/* Nothing left, drop the query including '?' */
+		if (uri->reserved == NULL) {
+			memory->free(memory, (URI_CHAR *)uri->query.first);
+		}
+		uri->query.first = NULL;
+		uri->query.afterLast = NULL;
+	} else {
+		uri->query.afterLast = queryAfterLast;
+	}
+
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(CanonicalizeQueryMalloc)(URI_CHAR ** dest,
+		int * charsWritten, const URI_CHAR * first, const URI_CHAR * afterLast,
+		unsigned int options) {
+	return URI_FUNC(CanonicalizeQueryMallocMm)(dest, charsWritten, first,
+			afterLast, options, NULL);
+}
+
+
+
+/* Orders ranges code unit by code unit, shorter prefixes first */
+static int URI_FUNC(CompareQueryRanges)(const URI_TYPE(TextRange) * a,
+		const URI_TYPE(TextRange) * b) {
+	const size_t lenA = (size_t)(a->afterLast - a->first);
+	const size_t lenB = (size_t)(b->afterLast - b->first);
+	size_t i = 0;
+
+	for (; (i < lenA) && (i < lenB); i++) {
+		if (a->first[i] != b->first[i]) {
+			return ((unsigned int)a->first[i] < (unsigned int)b->first[i])
+					? -1 : 1;
+		}
+	}
+
+	if (lenA == lenB) {
+		return 0;
+	}
+	return (lenA < lenB) ? -1 : 1;
+}
+
+
+
+/* Orders values like ranges, "no value" before any value */
+static int URI_FUNC(CompareQueryValues)(const URI_TYPE(TextRange) * a,
+		const URI_TYPE(TextRange) * b) {
+	if ((a->first == NULL) || (b->first == NULL)) {
+		if (a->first == b->first) {
+			return 0;
+		}
+		return (a->first == NULL) ? -1 : 1;
+	}
+	return URI_FUNC(CompareQueryRanges)(a, b);
+}
+
+
+
+/* Orders items by key, optionally by value, then by original position
+ * as recorded in member next */
+static int URI_FUNC(CompareQueryItems)(const URI_TYPE(QueryRangeList) * a,
+		const URI_TYPE(QueryRangeList) * b, UriBool byValue) {
+	int res = URI_FUNC(CompareQueryRanges)(&a->key, &b->key);
+
+	if ((res == 0) && byValue) {
+		res = URI_FUNC(CompareQueryValues)(&a->value, &b->value);
+	}
+	if (res == 0) {
+		if (a->next != b->next) {
+			res = (a->next < b->next) ? -1 : 1;
+		}
+	}
+	return res;
+}
+
+
+
+/* Bottom-up merge sort of items using scratch of equal size */
+static void URI_FUNC(SortQueryItems)(URI_TYPE(QueryRangeList) * items,
+		URI_TYPE(QueryRangeList) * scratch, size_t count, UriBool byValue) {
+	URI_TYPE(QueryRangeList) * from = items;
+	URI_TYPE(QueryRangeList) * to = scratch;
+	size_t width = 1;
+
+	for (; width < count; width *= 2) {
+		URI_TYPE(QueryRangeList) * const swap = from;
+		size_t left = 0;
+
+		for (; left < count; left += 2 * width) {
+			const size_t middle = (left + width < count) ? left + width : count;
+			const size_t right = (middle + width < count) ? middle + width : count;
+			size_t i = left;
+			size_t j = middle;
+			size_t k = left;
+
+			while ((i < middle) && (j < right)) {
+				if (URI_FUNC(CompareQueryItems)(&from[j], &from[i],
+						byValue) < 0) {
+					to[k++] = from[j++];
+				} else {
+					to[k++] = from[i++];
+				}
+			}
+			while (i < middle) {
+				to[k++] = from[i++];
+			}
+			while (j < right) {
+				to[k++] = from[j++];
+			}
+		}
+
+		from = to;
+		to = swap;
+	}
+
+	if (from != items) {
+		memcpy(items, from, count * sizeof(URI_TYPE(QueryRangeList)));
+	}
+}
+
+
+
+int URI_FUNC(CanonicalizeQueryMallocMm)(URI_CHAR ** dest,
+		int * charsWritten, const URI_CHAR * first, const URI_CHAR * afterLast,
+		unsigned int options, UriMemoryManager * memory) {
+	URI_TYPE(QueryIterator) iterator;
+	URI_TYPE(TextRange) key;
+	URI_TYPE(TextRange) value;
+	URI_TYPE(QueryRangeList) * items;
+	size_t len;
+	size_t textBytes;
+	size_t itemsTotal = 0;
+	size_t itemsKept = 0;
+	size_t index;
+	void * block;
+	URI_CHAR * output;
+	URI_CHAR * write;
+	const URI_CHAR * scratchWrite;
+
+	if ((dest == NULL) || (first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast);
+	while (URI_FUNC(QueryIteratorNext)(&iterator, &key, &value, NULL)) {
+		itemsTotal++;
+	}
+
+	/* Layout: [output][normalized items][items][merge scratch], output
+	 * first so that releasing *dest releases everything.  Neither output
+	 * nor normalized items can be longer than the input. */
+	len = (size_t)(afterLast - first);
+	if (len >= (size_t)INT_MAX) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+	textBytes = (2 * len + 1) * sizeof(URI_CHAR);
+	textBytes = (textBytes + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+	if (itemsTotal > (((size_t)-1) - textBytes)
+			/ (2 * sizeof(URI_TYPE(QueryRangeList)))) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	block = memory->malloc(memory, textBytes
+			+ 2 * itemsTotal * sizeof(URI_TYPE(QueryRangeList)));
+	if (block == NULL) {
+		return URI_ERROR_MALLOC;
+	}
+	output = (URI_CHAR *)block;
+	items = (URI_TYPE(QueryRangeList) *)((char *)block + textBytes);
+
+	/* Normalize percent-encodings item by item */
+	scratchWrite = output + len + 1;
+	URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast);
+	while (URI_FUNC(QueryIteratorNext)(&iterator, &key, &value, NULL)) {
+		URI_TYPE(QueryRangeList) * const item = items + itemsKept;
+
+		if (((options & URI_QUERY_CANONICAL_DROP_EMPTY) != 0)
+				&& ((key.first == key.afterLast)
+					|| ((value.first != NULL)
+						&& (value.first == value.afterLast)))) {
+			continue;
+		}
+
+		item->key.first = scratchWrite;
+		URI_FUNC(FixPercentEncodingEngine)(key.first, key.afterLast,
+				scratchWrite, &scratchWrite, URI_FALSE);
+		item->key.afterLast = scratchWrite;
+
+		if (value.first != NULL) {
+			item->value.first = scratchWrite;
+			URI_FUNC(FixPercentEncodingEngine)(value.first, value.afterLast,
+					scratchWrite, &scratchWrite, URI_FALSE);
+			item->value.afterLast = scratchWrite;
+		} else {
+			item->value.first = NULL;
+			item->value.afterLast = NULL;
+		}
+
+		/* Original position only, never dereferenced */
+		item->next = item;
+		itemsKept++;
+	}
+
+	if ((options & URI_QUERY_CANONICAL_DROP_DUPLICATES) != 0) {
+		size_t itemsUnique = 0;
+
+		/* Equal items become neighbors, first occurrence leading */
+		URI_FUNC(SortQueryItems)(items, items + itemsTotal, itemsKept,
+				URI_TRUE);
+		for (index = 0; index < itemsKept; index++) {
+			if ((itemsUnique > 0)
+					&& (URI_FUNC(CompareQueryRanges)(&items[itemsUnique - 1].key,
+						&items[index].key) == 0)
+					&& (URI_FUNC(CompareQueryValues)(&items[itemsUnique - 1].value,
+						&items[index].value) == 0)) {
+				continue;
+			}
+			items[itemsUnique++] = items[index];
+		}
+		itemsKept = itemsUnique;
+	}
+
+	/* Restore order of first occurrence within each key */
+	URI_FUNC(SortQueryItems)(items, items + itemsTotal, itemsKept, URI_FALSE);
+
+	/* Emit in order */
+	write = output;
+	for (index = 0; index < itemsKept; index++) {
+		const URI_TYPE(QueryRangeList) * const item = items + index;
+		size_t keyLen;
+
+		if (write != output) {
+			write[0] = _UT('&');
+			write++;
+		}
+
+		keyLen = (size_t)(item->key.afterLast - item->key.first);
+		memcpy(write, item->key.first, keyLen * sizeof(URI_CHAR));
+		write += keyLen;
+
+		if (item->value.first != NULL) {
+			const size_t valueLen
+					= (size_t)(item->value.afterLast - item->value.first);
+
+			write[0] = _UT('=');
+			write++;
+			memcpy(write, item->value.first, valueLen * sizeof(URI_CHAR));
+			write += valueLen;
+		}
+	}
+	write[0] = _UT('\0');
+
+	*dest = output;
+	if (charsWritten != NULL) {
+		*charsWritten = (int)(write - output) + 1;
+	}
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(QueryDecoderInit)(URI_TYPE(QueryDecoder) * decoder,
+		URI_TYPE(QueryItemCallback) callback, void * userData,
+		UriBool plusToSpace, UriBreakConversion breakConversion) {
+	return URI_FUNC(QueryDecoderInitMm)(decoder, callback, userData,
+			plusToSpace, breakConversion, NULL);
+}
+
+
+
+int URI_FUNC(QueryDecoderInitMm)(URI_TYPE(QueryDecoder) * decoder,
+		URI_TYPE(QueryItemCallback) callback, void * userData,
+		UriBool plusToSpace, UriBreakConversion breakConversion,
+		UriMemoryManager * memory) {
+	if ((decoder == NULL) || (callback == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	memset(decoder, 0, sizeof(URI_TYPE(QueryDecoder)));
+	decoder->plusToSpace = plusToSpace;
+	decoder->breakConversion = breakConversion;
+	decoder->callback = callback;
+	decoder->userData = userData;
+	decoder->memory = memory;
+	return URI_SUCCESS;
+}
+
+
+
+static int URI_FUNC(QueryDecoderEmit)(URI_TYPE(QueryDecoder) * decoder) {
+	URI_CHAR * value = NULL;
+	int res;
+
+	/* Neither key nor value, e.g. from "&&" */
+	if ((decoder->length == 0) && !decoder->separatorSeen) {
+		return URI_SUCCESS;
+	}
+
+	decoder->buffer[decoder->length] = _UT('\0');
+	if (decoder->separatorSeen) {
+		decoder->buffer[decoder->keyLength] = _UT('\0');
+		value = decoder->buffer + decoder->keyLength + 1;
+		URI_FUNC(UnescapeInPlaceEx)(value, decoder->plusToSpace,
+				decoder->breakConversion);
+	}
+	URI_FUNC(UnescapeInPlaceEx)(decoder->buffer, decoder->plusToSpace,
+			decoder->breakConversion);
+
+	res = decoder->callback(decoder->userData, decoder->buffer, value);
+
+	decoder->length = 0;
+	decoder->separatorSeen = URI_FALSE;
+	return res;
+}
+
+
+
+static int URI_FUNC(QueryDecoderAppend)(URI_TYPE(QueryDecoder) * decoder,
+		const URI_CHAR * first, const URI_CHAR * afterLast) {
+	const size_t count = (size_t)(afterLast - first);
+	const URI_CHAR * walk;
+
+	/* Keep room for the terminator */
+	if (decoder->length + count + 1 > decoder->capacity) {
+		size_t capacity = (decoder->capacity == 0) ? 64 : decoder->capacity;
+		URI_CHAR * buffer;
+
+		while (capacity < decoder->length + count + 1) {
+			if (capacity > ((size_t)-1) / 2 / sizeof(URI_CHAR)) {
+				return URI_ERROR_OUTPUT_TOO_LARGE;
+			}
+			capacity *= 2;
+		}
+
+		buffer = decoder->memory->realloc(decoder->memory, decoder->buffer,
+				capacity * sizeof(URI_CHAR));
+		if (buffer == NULL) {
+			return URI_ERROR_MALLOC;
+		}
+		decoder->buffer = buffer;
+		decoder->capacity = capacity;
+	}
+
+	if (!decoder->separatorSeen) {
+		for (walk = first; walk < afterLast; walk++) {
+			if (*walk == _UT('=')) {
+				decoder->keyLength = decoder->length + (size_t)(walk - first);
+				decoder->separatorSeen = URI_TRUE;
+				break;
+			}
+		}
+	}
+
+	memcpy(decoder->buffer + decoder->length, first, count * sizeof(URI_CHAR));
+	decoder->length += count;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(QueryDecoderFeed)(URI_TYPE(QueryDecoder) * decoder,
+		const URI_CHAR * first, const URI_CHAR * afterLast) {
+	const URI_CHAR * walk;
+
+	if ((decoder == NULL) || (first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	if (decoder->error != URI_SUCCESS) {
+		return decoder->error;
+	}
+
+	for (walk = first; walk < afterLast; walk++) {
+		if (*walk == _UT('&')) {
+			decoder->error = URI_FUNC(QueryDecoderAppend)(decoder, first, walk);
+			if (decoder->error != URI_SUCCESS) {
+				return decoder->error;
+			}
+			decoder->error = URI_FUNC(QueryDecoderEmit)(decoder);
+			if (decoder->error != URI_SUCCESS) {
+				return decoder->error;
+			}
+			first = walk + 1;
+		}
+	}
+
+	decoder->error = URI_FUNC(QueryDecoderAppend)(decoder, first, afterLast);
+	return decoder->error;
+}
+
+
+
+int URI_FUNC(QueryDecoderFinish)(URI_TYPE(QueryDecoder) * decoder) {
+	int res;
+
+	if (decoder == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	res = decoder->error;
+	if ((res == URI_SUCCESS) && (decoder->buffer != NULL)) {
+		res = URI_FUNC(QueryDecoderEmit)(decoder);
+		decoder->error = res;
+	}
+
+	if (decoder->memory != NULL) {
+		decoder->memory->free(decoder->memory, decoder->buffer);
+	}
+	decoder->buffer = NULL;
+	decoder->length = 0;
+	decoder->capacity = 0;
+	decoder->separatorSeen = URI_FALSE;
+	return res;
+}
+
+
+
+int URI_FUNC(QueryBuilderInit)(URI_TYPE(QueryBuilder) * builder,
+		URI_CHAR * dest, int maxChars,
+		UriBool spaceToPlus, UriBool normalizeBreaks) {
+	if ((builder == NULL) || (dest == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (maxChars < 1) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	memset(builder, 0, sizeof(URI_TYPE(QueryBuilder)));
+	builder->buffer = dest;
+	builder->buffer[0] = _UT('\0');
+	builder->capacity = (size_t)maxChars;
+	builder->spaceToPlus = spaceToPlus;
+	builder->normalizeBreaks = normalizeBreaks;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(QueryBuilderInitMm)(URI_TYPE(QueryBuilder) * builder,
+		UriBool spaceToPlus, UriBool normalizeBreaks,
+		UriMemoryManager * memory) {
+	if (builder == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	memset(builder, 0, sizeof(URI_TYPE(QueryBuilder)));
+	builder->spaceToPlus = spaceToPlus;
+	builder->normalizeBreaks = normalizeBreaks;
+	builder->memory = memory;
+	return URI_SUCCESS;
+}
+
+
+
+/* Makes sure the buffer can hold the given number of characters,
+ * growing it if managed */
+static int URI_FUNC(QueryBuilderReserve)(URI_TYPE(QueryBuilder) * builder,
+		size_t capacityRequired) {
+	size_t capacity = (builder->capacity == 0) ? 64 : builder->capacity;
+	URI_CHAR * buffer;
+
+	if (capacityRequired <= builder->capacity) {
+		return URI_SUCCESS;
+	}
+
+	if (builder->memory == NULL) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	while (capacity < capacityRequired) {
+		if (capacity > ((size_t)-1) / 2 / sizeof(URI_CHAR)) {
+			return URI_ERROR_OUTPUT_TOO_LARGE;
+		}
+		capacity *= 2;
+	}
+
+	buffer = builder->memory->realloc(builder->memory, builder->buffer,
+			capacity * sizeof(URI_CHAR));
+	if (buffer == NULL) {
+		return URI_ERROR_MALLOC;
+	}
+	builder->buffer = buffer;
+	builder->capacity = capacity;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(QueryBuilderAppend)(URI_TYPE(QueryBuilder) * builder,
+		const URI_CHAR * keyFirst, const URI_CHAR * keyAfterLast,
+		const URI_CHAR * valueFirst, const URI_CHAR * valueAfterLast) {
+	size_t ampersandLen;
+	size_t keyRequiredChars;
+	size_t valueRequiredChars = 0;
+	URI_CHAR * write;
+	int res;
+
+	if ((builder == NULL) || (keyFirst == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (((keyAfterLast != NULL) && (keyFirst > keyAfterLast))
+			|| ((valueFirst != NULL) && (valueAfterLast != NULL)
+				&& (valueFirst > valueAfterLast))) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	ampersandLen = (builder->itemCount == 0) ? 0 : 1;
+	keyRequiredChars = URI_FUNC(EscapedLength)(keyFirst, keyAfterLast,
+			builder->spaceToPlus, builder->normalizeBreaks);
+	if (valueFirst != NULL) {
+		valueRequiredChars = 1 + URI_FUNC(EscapedLength)(valueFirst,
+				valueAfterLast, builder->spaceToPlus, builder->normalizeBreaks);
+	}
+
+	/* Each part below a quarter keeps the sum from overflowing */
+	if ((builder->length > ((size_t)-1) / 4)
+			|| (keyRequiredChars > ((size_t)-1) / 4)
+			|| (valueRequiredChars > ((size_t)-1) / 4)) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+	res = URI_FUNC(QueryBuilderReserve)(builder, builder->length
+			+ ampersandLen + keyRequiredChars + valueRequiredChars + 1);
+	if (res != URI_SUCCESS) {
+		return res;
+	}
+
+	write = builder->buffer + builder->length;
+	if (ampersandLen == 1) {
+		write[0] = _UT('&');
+		write++;
+	}
+	write = URI_FUNC(EscapeEx)(keyFirst, keyAfterLast,
+			write, builder->spaceToPlus, builder->normalizeBreaks);
+
+	if (valueFirst != NULL) {
+		write[0] = _UT('=');
+		write++;
+		write = URI_FUNC(EscapeEx)(valueFirst, valueAfterLast,
+				write, builder->spaceToPlus, builder->normalizeBreaks);
+	}
+
+	builder->length = (size_t)(write - builder->buffer);
+	builder->itemCount++;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(QueryBuilderDetach)(URI_TYPE(QueryBuilder) * builder,
+		URI_CHAR ** dest) {
+	int res;
+
+	if ((builder == NULL) || (dest == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	/* Managed buffer with no items yet */
+	if (builder->buffer == NULL) {
+		res = URI_FUNC(QueryBuilderReserve)(builder, 1);
+		if (res != URI_SUCCESS) {
+			return res;
+		}
+		builder->buffer[0] = _UT('\0');
+	}
+
+	*dest = builder->buffer;
+	builder->buffer = NULL;
+	builder->length = 0;
+	builder->capacity = 0;
+	builder->itemCount = 0;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(QueryBuilderFree)(URI_TYPE(QueryBuilder) * builder) {
+	if (builder == NULL) {
+		return URI_ERROR_NULL;
+	}
+
+	if (builder->memory != NULL) {
+		builder->memory->free(builder->memory, builder->buffer);
+	}
+	builder->buffer = NULL;
+	builder->length = 0;
+	builder->capacity = 0;
+	builder->itemCount = 0;
+	return URI_SUCCESS;
+}
+
+
+
+int URI_FUNC(QueryIteratorInit)(URI_TYPE(QueryIterator) * iterator,
+		const URI_CHAR * first, const URI_CHAR * afterLast) {
+	if ((iterator == NULL) || (first == NULL) || (afterLast == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	if (first > afterLast) {
+		return URI_ERROR_RANGE_INVALID;
+	}
+
+	iterator->next = first;
+	iterator->afterLast = afterLast;
+	return URI_SUCCESS;
+}
+
+
+
+UriBool URI_FUNC(QueryIteratorNext)(URI_TYPE(QueryIterator) * iterator,
+		URI_TYPE(TextRange) * key, URI_TYPE(TextRange) * value,
+		UriBool * needsUnescape) {
+	if ((iterator == NULL) || (key == NULL) || (value == NULL)) {
+		return URI_FALSE;
+	}
+
+	while (iterator->next != NULL) {
+		const URI_CHAR * const itemFirst = iterator->next;
+		const URI_CHAR * separator = NULL;
+		UriBool escaped = URI_FALSE;
+		const URI_CHAR * walk = itemFirst;
+
+		for (; walk < iterator->afterLast; walk++) {
+			if (*walk == _UT('&')) {
+				break;
+			}
+			switch (*walk) {
+			case _UT('='):
+				/* NOTE: WE treat the first '=' as a separator, */
+				/*       all following go into the value part   */
+				if (separator == NULL) {
+					separator = walk;
+				}
+				break;
+
+			case _UT('%'):
+			case _UT('+'):
+				escaped = URI_TRUE;
+				break;
+
+			default:
+				break;
+			}
+		}
+
+		/* A trailing '&' opens one last empty item that is skipped below */
+		iterator->next = (walk < iterator->afterLast) ? walk + 1 : NULL;
+
+		if (separator == NULL) {
+			if (walk == itemFirst) {
+				continue;  /* Neither key nor value */
+			}
+			key->first = itemFirst;
+			key->afterLast = walk;
+			value->first = NULL;
+			value->afterLast = NULL;
+		} else {
+			key->first = itemFirst;
+			key->afterLast = separator;
+			value->first = separator + 1;
+			value->afterLast = walk;
+		}
+
+		if (needsUnescape != NULL) {
+			*needsUnescape = escaped;
+		}
+		return URI_TRUE;
+	}
+
+	return URI_FALSE;
+}
+
+
+
+/* Reads the next code unit of a raw query key the way
+ * uriUnescapeInPlaceEx(A|W) with URI_BR_DONT_TOUCH would produce it */
+static URI_INLINE URI_CHAR URI_FUNC(QueryKeyNextUnit)(const URI_CHAR ** walk,
+		const URI_CHAR * afterLast, UriBool plusToSpace) {
+	const URI_CHAR * const read = *walk;
+
+	if ((read[0] == _UT('%'))
+			&& (afterLast - read >= 3)
+			&& URI_FUNC(IsHexdig)(read[1])
+			&& URI_FUNC(IsHexdig)(read[2])) {
+		const unsigned char left = URI_FUNC(HexdigToInt)(read[1]);
+		const unsigned char right = URI_FUNC(HexdigToInt)(read[2]);
+		*walk = read + 3;
+		return (URI_CHAR)(16 * left + right);
+	}
+
+	*walk = read + 1;
+	if (plusToSpace && (read[0] == _UT('+'))) {
+		return _UT(' ');
+	}
+	return read[0];
+}
+
+
+
+static UriBool URI_FUNC(QueryKeyEquals)(const URI_TYPE(TextRange) * rawKey,
+		const URI_CHAR * key, const URI_CHAR * keyAfterLast,
+		UriBool plusToSpace) {
+	const URI_CHAR * walk = rawKey->first;
+
+	while (walk < rawKey->afterLast) {
+		if ((key >= keyAfterLast)
+				|| (URI_FUNC(QueryKeyNextUnit)(&walk, rawKey->afterLast,
+					plusToSpace) != *key)) {
+			return URI_FALSE;
+		}
+		key++;
+	}
+
+	return (key == keyAfterLast) ? URI_TRUE : URI_FALSE;
+}
+
+
+
+UriBool URI_FUNC(QueryFind)(const URI_CHAR * first,
+		const URI_CHAR * afterLast, const URI_CHAR * key,
+		const URI_CHAR * keyAfterLast, UriBool plusToSpace,
+		URI_TYPE(TextRange) * value) {
+	URI_TYPE(QueryIterator) iterator;
+
+	if (URI_FUNC(QueryIteratorInit)(&iterator, first, afterLast)
+			!= URI_SUCCESS) {
+		return URI_FALSE;
+	}
+
+	return URI_FUNC(QueryIteratorFind)(&iterator, key, keyAfterLast,
+			plusToSpace, value);
+}
+
+
+
+UriBool URI_FUNC(QueryIteratorFind)(URI_TYPE(QueryIterator) * iterator,
+		const URI_CHAR * key, const URI_CHAR * keyAfterLast,
+		UriBool plusToSpace, URI_TYPE(TextRange) * value) {
+	URI_TYPE(TextRange) rawKey;
+	URI_TYPE(TextRange) rawValue;
+
+	if ((iterator == NULL) || (key == NULL) || (value == NULL)) {
+		return URI_FALSE;
+	}
+
+	if (keyAfterLast == NULL) {
+		keyAfterLast = key + URI_STRLEN(key);
+	}
+
+	while (URI_FUNC(QueryIteratorNext)(iterator, &rawKey, &rawValue, NULL)) {
+		/* Raw keys never decode to more units than they hold */
+		if ((rawKey.afterLast - rawKey.first) < (keyAfterLast - key)) {
+			continue;
+		}
+
+		if (URI_FUNC(QueryKeyEquals)(&rawKey, key, keyAfterLast,
+				plusToSpace)) {
+			*value = rawValue;
+			return URI_TRUE;
+		}
+	}
+
+	return URI_FALSE;
+}
+
+
+
+int URI_FUNC(QueryKeySetInit)(URI_TYPE(QueryKeySet) * keySet,
+		const URI_CHAR * const * keys, int keyCount) {
+	int keyIndex;
+
+	if ((keySet == NULL) || ((keys == NULL) && (keyCount > 0))) {
+		return URI_ERROR_NULL;
+	}
+
+	if ((keyCount < 0) || (keyCount > URI_QUERY_KEY_SET_MAX_KEYS)) {
+		return URI_ERROR_OUTPUT_TOO_LARGE;
+	}
+
+	memset(keySet->slots, 0, sizeof(keySet->slots));
+	keySet->keys = keys;
+	keySet->keyCount = keyCount;
+
+	for (keyIndex = 0; keyIndex < keyCount; keyIndex++) {
+		const URI_CHAR * walk = keys[keyIndex];
+		unsigned int hash = URI_QUERY_HASH_INIT;
+		unsigned int slot;
+
+		if (walk == NULL) {
+			return URI_ERROR_NULL;
+		}
+
+		for (; *walk != _UT('\0'); walk++) {
+			hash = URI_QUERY_HASH_STEP(hash, *walk);
+		}
+		keySet->hashes[keyIndex] = hash;
+
+		/* Linear probing, the table is never more than half full */
+		slot = hash & (URI_QUERY_KEY_SET_SLOTS - 1);
+		while (keySet->slots[slot] != 0) {
+			slot = (slot + 1) & (URI_QUERY_KEY_SET_SLOTS - 1);
+		}
+		keySet->slots[slot] = (unsigned char)(keyIndex + 1);
+	}
+
+	return URI_SUCCESS;
+}
+
+
+
+UriBool URI_FUNC(QueryIteratorFindKeySet)(URI_TYPE(QueryIterator) * iterator,
+		const URI_TYPE(QueryKeySet) * keySet, UriBool plusToSpace,
+		int * keyIndex, URI_TYPE(TextRange) * value) {
+	URI_TYPE(TextRange) rawKey;
+	URI_TYPE(TextRange) rawValue;
+
+	if ((iterator == NULL) || (keySet == NULL) || (value == NULL)) {
+		return URI_FALSE;
+	}
+
+	while (URI_FUNC(QueryIteratorNext)(iterator, &rawKey, &rawValue, NULL)) {
+		const URI_CHAR * walk = rawKey.first;
+		unsigned int hash = URI_QUERY_HASH_INIT;
+		unsigned int slot;
+
+		while (walk < rawKey.afterLast) {
+			hash = URI_QUERY_HASH_STEP(hash, URI_FUNC(QueryKeyNextUnit)(&walk,
+					rawKey.afterLast, plusToSpace));
+		}
+
+		slot = hash & (URI_QUERY_KEY_SET_SLOTS - 1);
+		while (keySet->slots[slot] != 0) {
+			const int candidate = keySet->slots[slot] - 1;
+			if (keySet->hashes[candidate] == hash) {
+				const URI_CHAR * const key = keySet->keys[candidate];
+				if (URI_FUNC(QueryKeyEquals)(&rawKey, key,
+						key + URI_STRLEN(key), plusToSpace)) {
+					if (keyIndex != NULL) {
+						*keyIndex = candidate;
+					}
+					*value = rawValue;
+					return URI_TRUE;
+				}
+			}
+			slot = (slot + 1) & (URI_QUERY_KEY_SET_SLOTS - 1);
+		}
+	}
+
+	return URI_FALSE;
+}
+
+
+
 #endif
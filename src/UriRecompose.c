@@ -63,34 +63,414 @@
 
 #ifndef URI_DOXYGEN
 # include <uriparser/Uri.h>
+# include "UriNormalizeBase.h"
 # include "UriCommon.h"
+# include "UriMemory.h"
 #endif
 
 
 
+#include <limits.h>
+
+
+
+/* Characters tried on the stack before measuring, see uriToStringMallocExMmA */
+#ifndef URI_TO_STRING_STACK_CHARS
+# define URI_TO_STRING_STACK_CHARS  256
+#endif
+
+
+
+/* How AppendNormalized treats text, combinable */
+#ifndef URI_APPEND_LOWERCASE
+# define URI_APPEND_VERBATIM      0
+# define URI_APPEND_LOWERCASE     1
+# define URI_APPEND_FIX_PERCENT   2
+#endif
+
+
+
+/* State of a walk over the path as path segment normalization would
+ * leave it, see NextPathSegment */
+typedef struct URI_TYPE(PathWalkerStruct) {
+	const URI_TYPE(PathSegment) * next;
+	int depth; /* Segments kept so far that a ".." can still remove */
+	int parents; /* Leading ".." segments kept in relative references */
+	int parentsAhead; /* ".." segments not visited yet */
+	UriBool normalize;
+	UriBool relative;
+	UriBool hostSet;
+	UriBool absolutePath;
+} URI_TYPE(PathWalker);
+
+
+
 static int URI_FUNC(ToStringEngine)(URI_CHAR * dest, const URI_TYPE(Uri) * uri,
-		int maxChars, int * charsWritten, int * charsRequired);
+		unsigned int mask, int maxChars, int * charsWritten,
+		int * charsRequired);
+
+
+
+/* Length of the text of an immutable URI, -1 if unknown;
+ * only frozen URIs have it, see uriFreezeUriMmA */
+static URI_INLINE int URI_FUNC(CachedCharsRequired)(const URI_TYPE(Uri) * uri) {
+	if ((uri == NULL) || (uri->reserved == NULL)) {
+		return -1;
+	}
+	return ((const UriBlock *)uri->reserved)->charsRequired;
+}
 
 
 
 int URI_FUNC(ToStringCharsRequired)(const URI_TYPE(Uri) * uri,
 		int * charsRequired) {
 	const int MAX_CHARS = ((unsigned int)-1) >> 1;
-	return URI_FUNC(ToStringEngine)(NULL, uri, MAX_CHARS, NULL, charsRequired);
+	const int cached = URI_FUNC(CachedCharsRequired)(uri);
+	if ((cached >= 0) && (charsRequired != NULL)) {
+		*charsRequired = cached;
+		return URI_SUCCESS;
+	}
+	return URI_FUNC(ToStringEngine)(NULL, uri, URI_NORMALIZED, MAX_CHARS,
+			NULL, charsRequired);
 }
 
 
 
 int URI_FUNC(ToString)(URI_CHAR * dest, const URI_TYPE(Uri) * uri,
 		int maxChars, int * charsWritten) {
-	return URI_FUNC(ToStringEngine)(dest, uri, maxChars, charsWritten, NULL);
+	return URI_FUNC(ToStringEngine)(dest, uri, URI_NORMALIZED, maxChars,
+			charsWritten, NULL);
+}
+
+
+
+int URI_FUNC(ToNormalizedStringCharsRequired)(const URI_TYPE(Uri) * uri,
+		unsigned int mask, int * charsRequired) {
+	const int MAX_CHARS = ((unsigned int)-1) >> 1;
+	/* Scheme-based steps need to be asked for explicitly */
+	mask = URI_NORMALIZE_EFFECTIVE_MASK(mask);
+	return URI_FUNC(ToStringEngine)(NULL, uri, mask, MAX_CHARS, NULL,
+			charsRequired);
+}
+
+
+
+int URI_FUNC(ToNormalizedString)(URI_CHAR * dest, const URI_TYPE(Uri) * uri,
+		unsigned int mask, int maxChars, int * charsWritten) {
+	/* Scheme-based steps need to be asked for explicitly */
+	mask = URI_NORMALIZE_EFFECTIVE_MASK(mask);
+	return URI_FUNC(ToStringEngine)(dest, uri, mask, maxChars, charsWritten,
+			NULL);
+}
+
+
+
+int URI_FUNC(ToStringMalloc)(URI_CHAR ** dest, const URI_TYPE(Uri) * uri,
+		int * charsWritten) {
+	return URI_FUNC(ToStringMallocExMm)(dest, uri, URI_NORMALIZED,
+			charsWritten, NULL);
+}
+
+
+
+int URI_FUNC(ToStringMallocEx)(URI_CHAR ** dest, const URI_TYPE(Uri) * uri,
+		unsigned int mask, int * charsWritten) {
+	return URI_FUNC(ToStringMallocExMm)(dest, uri, mask, charsWritten, NULL);
+}
+
+
+
+int URI_FUNC(ToStringMallocExMm)(URI_CHAR ** dest, const URI_TYPE(Uri) * uri,
+		unsigned int mask, int * charsWritten, UriMemoryManager * memory) {
+	const int MAX_CHARS = ((unsigned int)-1) >> 1;
+	URI_CHAR stackBuffer[URI_TO_STRING_STACK_CHARS];
+	int charsRequired = -1;
+	int written;
+	URI_CHAR * text;
+	int res;
+
+	if ((dest == NULL) || (uri == NULL)) {
+		return URI_ERROR_NULL;
+	}
+
+	URI_CHECK_MEMORY_MANAGER(memory);  /* may return */
+
+	/* Scheme-based steps need to be asked for explicitly */
+	mask = URI_NORMALIZE_EFFECTIVE_MASK(mask);
+
+	if (mask == URI_NORMALIZED) {
+		charsRequired = URI_FUNC(CachedCharsRequired)(uri);
+	}
+
+	if (charsRequired < 0) {
+		/* Single walk for text that fits the stack buffer */
+		res = URI_FUNC(ToStringEngine)(stackBuffer, uri, mask,
+				URI_TO_STRING_STACK_CHARS, &written, NULL);
+		if (res == URI_SUCCESS) {
+			text = uriMallocKind(memory, written * sizeof(URI_CHAR),
+					URI_MEMORY_UNKNOWN);
+			if (text == NULL) {
+				return URI_ERROR_MALLOC;
+			}
+			memcpy(text, stackBuffer, written * sizeof(URI_CHAR));
+			*dest = text;
+			if (charsWritten != NULL) {
+				*charsWritten = written;
+			}
+			return URI_SUCCESS;
+		} else if (res != URI_ERROR_TOSTRING_TOO_LONG) {
+			return res;
+		}
+
+		/* Longer text, measure first */
+		res = URI_FUNC(ToStringEngine)(NULL, uri, mask, MAX_CHARS, NULL,
+				&charsRequired);
+		if (res != URI_SUCCESS) {
+			return res;
+		}
+	}
+
+	if (charsRequired == INT_MAX) {
+		return URI_ERROR_MALLOC;
+	}
+	charsRequired++;
+
+	text = uriMallocKind(memory, charsRequired * sizeof(URI_CHAR),
+			URI_MEMORY_UNKNOWN);
+	if (text == NULL) {
+		return URI_ERROR_MALLOC;
+	}
+
+	res = URI_FUNC(ToStringEngine)(text, uri, mask, charsRequired, &written,
+			NULL);
+	if (res != URI_SUCCESS) {
+		memory->free(memory, text);
+		return res;
+	}
+
+	*dest = text;
+	if (charsWritten != NULL) {
+		*charsWritten = written;
+	}
+	return URI_SUCCESS;
+}
+
+
+
+/* Length of the text after FixPercentEncodingEngine */
+static URI_INLINE int URI_FUNC(FixedPercentEncodingLength)(
+		const URI_CHAR * first, const URI_CHAR * afterLast) {
+	int lenInChars = 0;
+	while (first < afterLast) {
+		if ((first + 2 < afterLast)
+				&& (first[0] == _UT('%'))
+				&& URI_FUNC(IsHexdig)(first[1])
+				&& URI_FUNC(IsHexdig)(first[2])) {
+			const int code = 16 * URI_FUNC(HexdigToInt)(first[1])
+					+ URI_FUNC(HexdigToInt)(first[2]);
+			lenInChars += uriIsUnreserved(code) ? 1 : 3;
+			first += 3;
+		} else {
+			lenInChars++;
+			first++;
+		}
+	}
+	return lenInChars;
+}
+
+
+
+/* Appends text to dest the way uriNormalizeSyntaxExA would leave it,
+ * or only counts it into *charsRequired with dest NULL */
+static URI_INLINE UriBool URI_FUNC(AppendNormalized)(URI_CHAR * dest,
+		int maxChars, int * written, int * charsRequired,
+		const URI_CHAR * first, const URI_CHAR * afterLast, int how) {
+	const int charsToWrite = (how & URI_APPEND_FIX_PERCENT)
+			? URI_FUNC(FixedPercentEncodingLength)(first, afterLast)
+			: (int)(afterLast - first);
+	URI_CHAR * write;
+
+	if (dest == NULL) {
+		(*charsRequired) += charsToWrite;
+		return URI_TRUE;
+	}
+
+	if (*written + charsToWrite > maxChars) {
+		return URI_FALSE;
+	}
+	write = dest + *written;
+
+	if (how & URI_APPEND_FIX_PERCENT) {
+		const URI_CHAR * afterWrite;
+		URI_FUNC(FixPercentEncodingEngine)(first, afterLast, write, &afterWrite,
+				(how & URI_APPEND_LOWERCASE) ? URI_TRUE : URI_FALSE);
+	} else {
+		memcpy(write, first, charsToWrite * sizeof(URI_CHAR));
+		if (how & URI_APPEND_LOWERCASE) {
+			URI_FUNC(LowercaseInplace)(write, write + charsToWrite);
+		}
+	}
+	*written += charsToWrite;
+	return URI_TRUE;
+}
+
+
+
+/* Returns 1 for "." and 2 for ".." after percent-encoding normalization,
+ * so that "%2E" counts as a dot; 0 for all other segments */
+static int URI_FUNC(DotSegmentKind)(const URI_TYPE(PathSegment) * segment) {
+	const URI_CHAR * i = segment->text.first;
+	int dots = 0;
+	while (i < segment->text.afterLast) {
+		if (i[0] == _UT('.')) {
+			i++;
+		} else if ((i + 2 < segment->text.afterLast)
+				&& (i[0] == _UT('%'))
+				&& (i[1] == _UT('2'))
+				&& ((i[2] == _UT('E')) || (i[2] == _UT('e')))) {
+			i += 3;
+		} else {
+			return 0;
+		}
+		if (++dots > 2) {
+			return 0;
+		}
+	}
+	return dots;
+}
+
+
+
+static void URI_FUNC(PathWalkerInit)(URI_TYPE(PathWalker) * walker,
+		const URI_TYPE(Uri) * uri, unsigned int mask) {
+	const URI_TYPE(PathSegment) * segment;
+
+	walker->next = uri->pathHead;
+	walker->depth = 0;
+	walker->parents = 0;
+	walker->parentsAhead = 0;
+	walker->normalize = (mask & URI_NORMALIZE_PATH) ? URI_TRUE : URI_FALSE;
+	walker->relative = ((uri->scheme.first == NULL) && !uri->absolutePath)
+			? URI_TRUE : URI_FALSE;
+	walker->hostSet = URI_FUNC(IsHostSet)(uri);
+	walker->absolutePath = uri->absolutePath;
+
+	if (walker->normalize) {
+		for (segment = uri->pathHead; segment != NULL; segment = segment->next) {
+			if (URI_FUNC(DotSegmentKind)(segment) == 2) {
+				walker->parentsAhead++;
+			}
+		}
+	}
+}
+
+
+
+/* Tells if a segment just kept will survive the ".." segments following it */
+static UriBool URI_FUNC(PathSegmentSurvives)(
+		const URI_TYPE(PathWalker) * walker) {
+	const URI_TYPE(PathSegment) * segment = walker->next;
+	int parentsLeft = walker->parentsAhead;
+	int depth = 0;
+
+	/* Once more segments are stacked on top than there are ".." left,
+	 * nothing can reach down here anymore */
+	for (; (segment != NULL) && (depth < parentsLeft); segment = segment->next) {
+		switch (URI_FUNC(DotSegmentKind)(segment)) {
+		case 0:
+			depth++;
+			break;
+
+		case 2:
+			if (depth == 0) {
+				return URI_FALSE;
+			}
+			depth--;
+			parentsLeft--;
+			break;
+		}
+	}
+	return URI_TRUE;
+}
+
+
+
+/* Yields the next path segment as uriNormalizeSyntaxExA would leave it,
+ * mirroring RemoveDotSegmentsEx without modifying anything */
+static UriBool URI_FUNC(NextPathSegment)(URI_TYPE(PathWalker) * walker,
+		const URI_CHAR ** first, const URI_CHAR ** afterLast) {
+	UriBool trailingSlash = URI_FALSE;
+
+	while (walker->next != NULL) {
+		const URI_TYPE(PathSegment) * const segment = walker->next;
+		const int dots = walker->normalize
+				? URI_FUNC(DotSegmentKind)(segment) : 0;
+		const UriBool last = (segment->next == NULL) ? URI_TRUE : URI_FALSE;
+		walker->next = segment->next;
+
+		if (dots == 1) {
+			/* "." is essential in front of a segment with a colon */
+			UriBool essential = URI_FALSE;
+			if (walker->relative && (walker->depth == 0)
+					&& (walker->parents == 0) && !last) {
+				const URI_CHAR * ch = segment->next->text.first;
+				for (; ch < segment->next->text.afterLast; ch++) {
+					if (*ch == _UT(':')) {
+						essential = URI_TRUE;
+						break;
+					}
+				}
+			}
+
+			if (!essential) {
+				if (last && ((walker->depth + walker->parents > 0)
+						|| walker->hostSet)) {
+					trailingSlash = URI_TRUE;
+				}
+				continue;
+			}
+		} else if (dots == 2) {
+			walker->parentsAhead--;
+			if (walker->depth > 0) {
+				/* Removes the previous segment */
+				walker->depth--;
+				trailingSlash = last;
+				continue;
+			} else if (!walker->relative) {
+				trailingSlash = (last && !walker->absolutePath)
+						? URI_TRUE : URI_FALSE;
+				continue;
+			}
+
+			/* Leading ".." of a relative reference */
+			walker->parents++;
+			*first = segment->text.first;
+			*afterLast = segment->text.afterLast;
+			return URI_TRUE;
+		}
+
+		walker->depth++;
+		if (URI_FUNC(PathSegmentSurvives)(walker)) {
+			*first = segment->text.first;
+			*afterLast = segment->text.afterLast;
+			return URI_TRUE;
+		}
+	}
+
+	if (trailingSlash) {
+		/* Empty segment left behind by a last "." or ".." */
+		*first = URI_FUNC(SafeToPointTo);
+		*afterLast = URI_FUNC(SafeToPointTo);
+		return URI_TRUE;
+	}
+	return URI_FALSE;
 }
 
 
 
 static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
-		const URI_TYPE(Uri) * uri, int maxChars, int * charsWritten,
-		int * charsRequired) {
+		const URI_TYPE(Uri) * uri, unsigned int mask, int maxChars,
+		int * charsWritten, int * charsRequired) {
 	int written = 0;
 	if ((uri == NULL) || ((dest == NULL) && (charsRequired == NULL))) {
 		if (charsWritten != NULL) {
@@ -116,22 +496,15 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 	/* [02/19]	if defined(scheme) then */
 				if (uri->scheme.first != NULL) {
 	/* [03/19]		append scheme to result; */
-					const int charsToWrite
-							= (int)(uri->scheme.afterLast - uri->scheme.first);
-					if (dest != NULL) {
-						if (written + charsToWrite <= maxChars) {
-							memcpy(dest + written, uri->scheme.first,
-									charsToWrite * sizeof(URI_CHAR));
-							written += charsToWrite;
-						} else {
-							dest[0] = _UT('\0');
-							if (charsWritten != NULL) {
-								*charsWritten = 0;
-							}
-							return URI_ERROR_TOSTRING_TOO_LONG;
+					if (!URI_FUNC(AppendNormalized)(dest, maxChars, &written,
+							charsRequired, uri->scheme.first, uri->scheme.afterLast,
+							(mask & URI_NORMALIZE_SCHEME)
+								? URI_APPEND_LOWERCASE : URI_APPEND_VERBATIM)) {
+						dest[0] = _UT('\0');
+						if (charsWritten != NULL) {
+							*charsWritten = 0;
 						}
-					} else {
-						(*charsRequired) += charsToWrite;
+						return URI_ERROR_TOSTRING_TOO_LONG;
 					}
 	/* [04/19]		append ":" to result; */
 					if (dest != NULL) {
@@ -172,20 +545,18 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 	/* [08/19]		append authority to result; */
 					/* UserInfo */
 					if (uri->userInfo.first != NULL) {
-						const int charsToWrite = (int)(uri->userInfo.afterLast - uri->userInfo.first);
-						if (dest != NULL) {
-							if (written + charsToWrite <= maxChars) {
-								memcpy(dest + written, uri->userInfo.first,
-										charsToWrite * sizeof(URI_CHAR));
-								written += charsToWrite;
-							} else {
-								dest[0] = _UT('\0');
-								if (charsWritten != NULL) {
-									*charsWritten = 0;
-								}
-								return URI_ERROR_TOSTRING_TOO_LONG;
+						if (!URI_FUNC(AppendNormalized)(dest, maxChars, &written,
+								charsRequired, uri->userInfo.first, uri->userInfo.afterLast,
+								(mask & URI_NORMALIZE_USER_INFO)
+									? URI_APPEND_FIX_PERCENT : URI_APPEND_VERBATIM)) {
+							dest[0] = _UT('\0');
+							if (charsWritten != NULL) {
+								*charsWritten = 0;
 							}
+							return URI_ERROR_TOSTRING_TOO_LONG;
+						}
 
+						if (dest != NULL) {
 							if (written + 1 <= maxChars) {
 								memcpy(dest + written, _UT("@"),
 										1 * sizeof(URI_CHAR));
@@ -198,7 +569,7 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 								return URI_ERROR_TOSTRING_TOO_LONG;
 							}
 						} else {
-							(*charsRequired) += charsToWrite + 1;
+							(*charsRequired) += 1;
 						}
 					}
 
@@ -324,8 +695,6 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 						}
 					} else if (uri->hostData.ipFuture.first != NULL) {
 						/* IPvFuture */
-						const int charsToWrite = (int)(uri->hostData.ipFuture.afterLast
-								- uri->hostData.ipFuture.first);
 						if (dest != NULL) {
 							if (written + 1 <= maxChars) {
 								memcpy(dest + written, _UT("["),
@@ -339,17 +708,23 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 								return URI_ERROR_TOSTRING_TOO_LONG;
 							}
 
-							if (written + charsToWrite <= maxChars) {
-								memcpy(dest + written, uri->hostData.ipFuture.first, charsToWrite * sizeof(URI_CHAR));
-								written += charsToWrite;
-							} else {
-								dest[0] = _UT('\0');
-								if (charsWritten != NULL) {
-									*charsWritten = 0;
-								}
-								return URI_ERROR_TOSTRING_TOO_LONG;
+						} else {
+							(*charsRequired) += 1;
+						}
+
+						if (!URI_FUNC(AppendNormalized)(dest, maxChars, &written,
+								charsRequired, uri->hostData.ipFuture.first,
+								uri->hostData.ipFuture.afterLast,
+								(mask & URI_NORMALIZE_HOST)
+									? URI_APPEND_LOWERCASE : URI_APPEND_VERBATIM)) {
+							dest[0] = _UT('\0');
+							if (charsWritten != NULL) {
+								*charsWritten = 0;
 							}
+							return URI_ERROR_TOSTRING_TOO_LONG;
+						}
 
+						if (dest != NULL) {
 							if (written + 1 <= maxChars) {
 								memcpy(dest + written, _UT("]"),
 										1 * sizeof(URI_CHAR));
@@ -362,30 +737,27 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 								return URI_ERROR_TOSTRING_TOO_LONG;
 							}
 						} else {
-							(*charsRequired) += 1 + charsToWrite + 1;
+							(*charsRequired) += 1;
 						}
 					} else if (uri->hostText.first != NULL) {
 						/* Regname */
-						const int charsToWrite = (int)(uri->hostText.afterLast - uri->hostText.first);
-						if (dest != NULL) {
-							if (written + charsToWrite <= maxChars) {
-								memcpy(dest + written, uri->hostText.first,
-										charsToWrite * sizeof(URI_CHAR));
-								written += charsToWrite;
-							} else {
-								dest[0] = _UT('\0');
-								if (charsWritten != NULL) {
-									*charsWritten = 0;
-								}
-								return URI_ERROR_TOSTRING_TOO_LONG;
+						if (!URI_FUNC(AppendNormalized)(dest, maxChars, &written,
+								charsRequired, uri->hostText.first, uri->hostText.afterLast,
+								(mask & URI_NORMALIZE_HOST)
+									? (URI_APPEND_FIX_PERCENT | URI_APPEND_LOWERCASE)
+									: URI_APPEND_VERBATIM)) {
+							dest[0] = _UT('\0');
+							if (charsWritten != NULL) {
+								*charsWritten = 0;
 							}
-						} else {
-							(*charsRequired) += charsToWrite;
+							return URI_ERROR_TOSTRING_TOO_LONG;
 						}
 					}
 
 					/* Port */
-					if (uri->portText.first != NULL) {
+					if ((uri->portText.first != NULL)
+							&& !((mask & URI_NORMALIZE_PORT)
+								&& URI_FUNC(IsPortRedundant)(uri))) {
 						const int charsToWrite = (int)(uri->portText.afterLast - uri->portText.first);
 						if (dest != NULL) {
 							/* Leading ':' */
@@ -420,35 +792,26 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 	/* [09/19]	endif; */
 				}
 	/* [10/19]	append path to result; */
-				/* Slash needed here? */
-				if (uri->absolutePath || ((uri->pathHead != NULL)
-						&& URI_FUNC(IsHostSet)(uri))) {
-					if (dest != NULL) {
-						if (written + 1 <= maxChars) {
-							memcpy(dest + written, _UT("/"),
-									1 * sizeof(URI_CHAR));
-							written += 1;
-						} else {
-							dest[0] = _UT('\0');
-							if (charsWritten != NULL) {
-								*charsWritten = 0;
-							}
-							return URI_ERROR_TOSTRING_TOO_LONG;
-						}
-					} else {
-						(*charsRequired) += 1;
-					}
-				}
-
-				if (uri->pathHead != NULL) {
-					URI_TYPE(PathSegment) * walker = uri->pathHead;
-					do {
-						const int charsToWrite = (int)(walker->text.afterLast - walker->text.first);
+				{
+					URI_TYPE(PathWalker) walker;
+					URI_TYPE(PathWalker) peek;
+					const URI_CHAR * first;
+					const URI_CHAR * afterLast;
+					UriBool firstSegment = URI_TRUE;
+
+					URI_FUNC(PathWalkerInit)(&walker, uri, mask);
+					peek = walker;
+
+					/* Slash needed here? */
+					if (uri->absolutePath || (URI_FUNC(IsHostSet)(uri)
+							&& URI_FUNC(NextPathSegment)(&peek, &first, &afterLast))
+							|| ((mask & URI_NORMALIZE_EMPTY_PATH)
+								&& URI_FUNC(IsEmptyPathRoot)(uri))) {
 						if (dest != NULL) {
-							if (written + charsToWrite <= maxChars) {
-								memcpy(dest + written, walker->text.first,
-										charsToWrite * sizeof(URI_CHAR));
-								written += charsToWrite;
+							if (written + 1 <= maxChars) {
+								memcpy(dest + written, _UT("/"),
+										1 * sizeof(URI_CHAR));
+								written += 1;
 							} else {
 								dest[0] = _UT('\0');
 								if (charsWritten != NULL) {
@@ -457,11 +820,13 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 								return URI_ERROR_TOSTRING_TOO_LONG;
 							}
 						} else {
-							(*charsRequired) += charsToWrite;
+							(*charsRequired) += 1;
 						}
+					}
 
-						/* Not last segment -> append slash */
-						if (walker->next != NULL) {
+					while (URI_FUNC(NextPathSegment)(&walker, &first, &afterLast)) {
+						/* Not first segment -> prepend slash */
+						if (!firstSegment) {
 							if (dest != NULL) {
 								if (written + 1 <= maxChars) {
 									memcpy(dest + written, _UT("/"),
@@ -478,12 +843,24 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 								(*charsRequired) += 1;
 							}
 						}
+						firstSegment = URI_FALSE;
 
-						walker = walker->next;
-					} while (walker != NULL);
+						if (!URI_FUNC(AppendNormalized)(dest, maxChars, &written,
+								charsRequired, first, afterLast,
+								walker.normalize
+									? URI_APPEND_FIX_PERCENT : URI_APPEND_VERBATIM)) {
+							dest[0] = _UT('\0');
+							if (charsWritten != NULL) {
+								*charsWritten = 0;
+							}
+							return URI_ERROR_TOSTRING_TOO_LONG;
+						}
+					}
 				}
 	/* [11/19]	if defined(query) then */
-				if (uri->query.first != NULL) {
+				if ((uri->query.first != NULL)
+						&& !((mask & URI_NORMALIZE_EMPTY_QUERY)
+							&& (uri->query.first == uri->query.afterLast))) {
 	/* [12/19]		append "?" to result; */
 					if (dest != NULL) {
 						if (written + 1 <= maxChars) {
@@ -501,29 +878,21 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 						(*charsRequired) += 1;
 					}
 	/* [13/19]		append query to result; */
-					{
-						const int charsToWrite
-								= (int)(uri->query.afterLast - uri->query.first);
-						if (dest != NULL) {
-							if (written + charsToWrite <= maxChars) {
-								memcpy(dest + written, uri->query.first,
-										charsToWrite * sizeof(URI_CHAR));
-								written += charsToWrite;
-							} else {
-								dest[0] = _UT('\0');
-								if (charsWritten != NULL) {
-									*charsWritten = 0;
-								}
-								return URI_ERROR_TOSTRING_TOO_LONG;
-							}
-						} else {
-							(*charsRequired) += charsToWrite;
+					if (!URI_FUNC(AppendNormalized)(dest, maxChars, &written,
+							charsRequired, uri->query.first, uri->query.afterLast,
+							(mask & URI_NORMALIZE_QUERY)
+								? URI_APPEND_FIX_PERCENT : URI_APPEND_VERBATIM)) {
+						dest[0] = _UT('\0');
+						if (charsWritten != NULL) {
+							*charsWritten = 0;
 						}
+						return URI_ERROR_TOSTRING_TOO_LONG;
 					}
 	/* [14/19]	endif; */
 				}
 	/* [15/19]	if defined(fragment) then */
-				if (uri->fragment.first != NULL) {
+				if ((uri->fragment.first != NULL)
+						&& !(mask & URI_NORMALIZE_DROP_FRAGMENT)) {
 	/* [16/19]		append "#" to result; */
 					if (dest != NULL) {
 						if (written + 1 <= maxChars) {
@@ -541,24 +910,15 @@ static URI_INLINE int URI_FUNC(ToStringEngine)(URI_CHAR * dest,
 						(*charsRequired) += 1;
 					}
 	/* [17/19]		append fragment to result; */
-					{
-						const int charsToWrite
-								= (int)(uri->fragment.afterLast - uri->fragment.first);
-						if (dest != NULL) {
-							if (written + charsToWrite <= maxChars) {
-								memcpy(dest + written, uri->fragment.first,
-										charsToWrite * sizeof(URI_CHAR));
-								written += charsToWrite;
-							} else {
-								dest[0] = _UT('\0');
-								if (charsWritten != NULL) {
-									*charsWritten = 0;
-								}
-								return URI_ERROR_TOSTRING_TOO_LONG;
-							}
-						} else {
-							(*charsRequired) += charsToWrite;
+					if (!URI_FUNC(AppendNormalized)(dest, maxChars, &written,
+							charsRequired, uri->fragment.first, uri->fragment.afterLast,
+							(mask & URI_NORMALIZE_FRAGMENT)
+								? URI_APPEND_FIX_PERCENT : URI_APPEND_VERBATIM)) {
+						dest[0] = _UT('\0');
+						if (charsWritten != NULL) {
+							*charsWritten = 0;
 						}
+						return URI_ERROR_TOSTRING_TOO_LONG;
 					}
 	/* [18/19]	endif; */
 				}
@@ -81,7 +81,7 @@ static URI_INLINE UriBool URI_FUNC(MergePath)(URI_TYPE(Uri) * absWork,
 
 	/* Replace last segment ("" if trailing slash) with first of append chain */
 	if (absWork->pathHead == NULL) {
-		URI_TYPE(PathSegment) * const dup = memory->malloc(memory, sizeof(URI_TYPE(PathSegment)));
+		URI_TYPE(PathSegment) * const dup = uriMallocNode(memory, sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
 		if (dup == NULL) {
 			return URI_FALSE; /* Raises malloc error */
 		}
@@ -100,7 +100,7 @@ static URI_INLINE UriBool URI_FUNC(MergePath)(URI_TYPE(Uri) * absWork,
 	destPrev = absWork->pathTail;
 
 	for (;;) {
-		URI_TYPE(PathSegment) * const dup = memory->malloc(memory, sizeof(URI_TYPE(PathSegment)));
+		URI_TYPE(PathSegment) * const dup = uriMallocNode(memory, sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
 		if (dup == NULL) {
 			destPrev->next = NULL;
 			absWork->pathTail = destPrev;
@@ -131,7 +131,7 @@ static int URI_FUNC(ResolveAbsolutePathFlag)(URI_TYPE(Uri) * absWork,
 	if (URI_FUNC(IsHostSet)(absWork) && absWork->absolutePath) {
 		/* Empty segment needed, instead? */
 		if (absWork->pathHead == NULL) {
-			URI_TYPE(PathSegment) * const segment = memory->malloc(memory, sizeof(URI_TYPE(PathSegment)));
+			URI_TYPE(PathSegment) * const segment = uriMallocNode(memory, sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
 			if (segment == NULL) {
 				return URI_ERROR_MALLOC;
 			}
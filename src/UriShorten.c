@@ -73,7 +73,7 @@ static URI_INLINE UriBool URI_FUNC(AppendSegment)(URI_TYPE(Uri) * uri,
 		const URI_CHAR * first, const URI_CHAR * afterLast,
 		UriMemoryManager * memory) {
 	/* Create segment */
-	URI_TYPE(PathSegment) * segment = memory->malloc(memory, 1 * sizeof(URI_TYPE(PathSegment)));
+	URI_TYPE(PathSegment) * segment = uriMallocNode(memory, sizeof(URI_TYPE(PathSegment)), URI_MEMORY_PATH_SEGMENT);
 	if (segment == NULL) {
 		return URI_FALSE; /* Raises malloc error */
 	}
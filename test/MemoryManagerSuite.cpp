@@ -24,6 +24,7 @@
 #include <cassert>
 #include <cerrno>
 #include <cstring>  // memcpy
+#include <map>
 #include <gtest/gtest.h>
 
 #include <uriparser/Uri.h>
@@ -288,6 +289,269 @@ TEST(MemoryManagerTestingSuite, EmulateCallocAndReallocarray) {
 
 
 
+TEST(MemoryManagerTestingSuite, AccountMemoryManager) {
+	UriMemoryManager memory;
+	UriMemoryAccounting accounting;
+
+	ASSERT_EQ(uriAccountMemoryManager(&memory, &accounting,
+			&defaultMemoryManager), URI_SUCCESS);
+
+	ASSERT_EQ(uriTestMemoryManager(&memory), URI_SUCCESS);
+
+	UriMemoryStats stats;
+	ASSERT_EQ(uriGetMemoryStats(&memory, &stats), URI_SUCCESS);
+	EXPECT_EQ(stats.bytesCurrent, 0U);
+	EXPECT_GE(stats.bytesPeak, 5U * 7U);
+	EXPECT_GT(stats.mallocCalls, 0U);
+	EXPECT_EQ(stats.callocCalls, 1U);
+	EXPECT_GT(stats.reallocCalls, 0U);
+	EXPECT_GT(stats.reallocarrayCalls, 0U);
+	EXPECT_GT(stats.freeCalls, 0U);
+	EXPECT_EQ(stats.failedCalls, 0U);
+}
+
+
+
+TEST(MemoryManagerAccountingSuite, IncompleteBackendRejected) {
+	UriMemoryManager memory;
+	UriMemoryAccounting accounting;
+	UriMemoryManager backend;
+
+	memset(&backend, 0, sizeof(UriMemoryManager));
+	backend.malloc = defaultMemoryManager.malloc;
+	backend.free = defaultMemoryManager.free;
+
+	ASSERT_EQ(uriAccountMemoryManager(&memory, &accounting, &backend),
+			URI_ERROR_MEMORY_MANAGER_INCOMPLETE);
+	ASSERT_EQ(uriAccountMemoryManager(&memory, &accounting, NULL),
+			URI_ERROR_NULL);
+}
+
+
+
+TEST(MemoryManagerAccountingSuite, OtherMemoryManagerRejected) {
+	UriMemoryStats stats;
+
+	ASSERT_EQ(uriGetMemoryStats(&defaultMemoryManager, &stats),
+			URI_ERROR_MEMORY_MANAGER_NOT_ACCOUNTING);
+	ASSERT_EQ(uriResetMemoryStats(&defaultMemoryManager),
+			URI_ERROR_MEMORY_MANAGER_NOT_ACCOUNTING);
+}
+
+
+
+TEST(MemoryManagerAccountingSuite, CurrentAndPeak) {
+	UriMemoryManager memory;
+	UriMemoryAccounting accounting;
+	UriMemoryStats stats;
+
+	ASSERT_EQ(uriAccountMemoryManager(&memory, &accounting,
+			&defaultMemoryManager), URI_SUCCESS);
+
+	void * const a = memory.malloc(&memory, 100);
+	void * b = memory.calloc(&memory, 10, 5);
+	ASSERT_TRUE(a != NULL);
+	ASSERT_TRUE(b != NULL);
+	b = memory.realloc(&memory, b, 20);
+	ASSERT_TRUE(b != NULL);
+
+	ASSERT_EQ(uriGetMemoryStats(&memory, &stats), URI_SUCCESS);
+	EXPECT_EQ(stats.bytesCurrent, 120U);
+	EXPECT_EQ(stats.bytesPeak, 150U);
+
+	memory.free(&memory, a);
+	ASSERT_EQ(uriResetMemoryStats(&memory), URI_SUCCESS);
+
+	ASSERT_EQ(uriGetMemoryStats(&memory, &stats), URI_SUCCESS);
+	EXPECT_EQ(stats.bytesCurrent, 20U);
+	EXPECT_EQ(stats.bytesPeak, 20U);
+	EXPECT_EQ(stats.mallocCalls, 0U);
+	EXPECT_EQ(stats.freeCalls, 0U);
+
+	memory.free(&memory, b);
+	ASSERT_EQ(uriGetMemoryStats(&memory, &stats), URI_SUCCESS);
+	EXPECT_EQ(stats.bytesCurrent, 0U);
+	EXPECT_EQ(stats.freeCalls, 1U);
+}
+
+
+
+TEST(MemoryManagerAccountingSuite, ParseAndFreeBalanced) {
+	UriMemoryManager memory;
+	UriMemoryAccounting accounting;
+	UriMemoryStats stats;
+	UriUriA uri;
+	const char * const first = "http://example.org/one/two/three?k=v#f";
+	const char * const afterLast = first + strlen(first);
+
+	ASSERT_EQ(uriAccountMemoryManager(&memory, &accounting,
+			&defaultMemoryManager), URI_SUCCESS);
+
+	ASSERT_EQ(uriParseSingleUriExMmA(&uri, first, afterLast, NULL, &memory),
+			URI_SUCCESS);
+	ASSERT_EQ(uriMakeOwnerMmA(&uri, &memory), URI_SUCCESS);
+
+	ASSERT_EQ(uriGetMemoryStats(&memory, &stats), URI_SUCCESS);
+	EXPECT_GT(stats.bytesCurrent, 0U);
+	EXPECT_GE(stats.bytesPeak, stats.bytesCurrent);
+
+	ASSERT_EQ(uriFreeUriMembersMmA(&uri, &memory), URI_SUCCESS);
+
+	ASSERT_EQ(uriGetMemoryStats(&memory, &stats), URI_SUCCESS);
+	EXPECT_EQ(stats.bytesCurrent, 0U);
+	EXPECT_EQ(stats.freeCalls, stats.mallocCalls + stats.callocCalls);
+}
+
+
+
+namespace {
+
+// Sized backend that checks that every release matches its allocation
+class CheckingSizedBackend {
+public:
+	UriSizedMemoryBackend backend;
+	std::map<void *, std::pair<size_t, UriMemoryKind> > live;
+	unsigned int callCountMismatch;
+	unsigned int callCountByKind[URI_MEMORY_QUERY_LIST + 1];
+
+	CheckingSizedBackend() : callCountMismatch(0) {
+		backend.malloc = checkingMalloc;
+		backend.free = checkingFree;
+		backend.userData = this;
+		memset(callCountByKind, 0, sizeof(callCountByKind));
+	}
+
+private:
+	static void * checkingMalloc(UriSizedMemoryBackend * backend,
+			size_t size, UriMemoryKind kind) {
+		CheckingSizedBackend * const self
+				= static_cast<CheckingSizedBackend *>(backend->userData);
+		void * const buffer = malloc(size);
+		if (buffer != NULL) {
+			self->live[buffer] = std::make_pair(size, kind);
+			self->callCountByKind[kind]++;
+		}
+		return buffer;
+	}
+
+	static void checkingFree(UriSizedMemoryBackend * backend, void * ptr,
+			size_t size, UriMemoryKind kind) {
+		CheckingSizedBackend * const self
+				= static_cast<CheckingSizedBackend *>(backend->userData);
+		std::map<void *, std::pair<size_t, UriMemoryKind> >::iterator
+				found = self->live.find(ptr);
+		if ((found == self->live.end()) || (found->second.first != size)
+				|| (found->second.second != kind)) {
+			self->callCountMismatch++;
+		}
+		if (found != self->live.end()) {
+			self->live.erase(found);
+		}
+		free(ptr);
+	}
+};
+
+}  // namespace
+
+
+
+TEST(MemoryManagerTestingSuite, CompleteSizedMemoryManager) {
+	UriMemoryManager memory;
+	CheckingSizedBackend sized;
+
+	ASSERT_EQ(uriCompleteSizedMemoryManager(&memory, &sized.backend),
+			URI_SUCCESS);
+
+	ASSERT_EQ(uriTestMemoryManager(&memory), URI_SUCCESS);
+	EXPECT_EQ(sized.callCountMismatch, 0U);
+	EXPECT_TRUE(sized.live.empty());
+}
+
+
+
+TEST(MemoryManagerSizedSuite, IncompleteBackendRejected) {
+	UriMemoryManager memory;
+	UriSizedMemoryBackend backend;
+
+	memset(&backend, 0, sizeof(UriSizedMemoryBackend));
+
+	ASSERT_EQ(uriCompleteSizedMemoryManager(&memory, &backend),
+			URI_ERROR_MEMORY_MANAGER_INCOMPLETE);
+	ASSERT_EQ(uriCompleteSizedMemoryManager(&memory, NULL),
+			URI_ERROR_NULL);
+}
+
+
+
+TEST(MemoryManagerSizedSuite, UriLifecycle) {
+	UriMemoryManager memory;
+	CheckingSizedBackend sized;
+	UriUriA uri;
+	UriUriA base;
+	UriUriA resolved;
+	const char * const first = "HTTP://[::1]/one/./two/../three?k=v#f";
+	const char * const afterLast = first + strlen(first);
+	const char * const baseFirst = "http://127.0.0.1/a/b/c";
+	const char * const baseAfterLast = baseFirst + strlen(baseFirst);
+	const char * const relFirst = "../d/e";
+	const char * const relAfterLast = relFirst + strlen(relFirst);
+
+	ASSERT_EQ(uriCompleteSizedMemoryManager(&memory, &sized.backend),
+			URI_SUCCESS);
+
+	ASSERT_EQ(uriParseSingleUriExMmA(&uri, first, afterLast, NULL, &memory),
+			URI_SUCCESS);
+	ASSERT_EQ(uriNormalizeSyntaxExMmA(&uri, (unsigned int)-1, &memory),
+			URI_SUCCESS);
+	ASSERT_EQ(uriFreeUriMembersMmA(&uri, &memory), URI_SUCCESS);
+
+	ASSERT_EQ(uriParseSingleUriExMmA(&base, baseFirst, baseAfterLast, NULL,
+			&memory), URI_SUCCESS);
+	ASSERT_EQ(uriParseSingleUriExMmA(&uri, relFirst, relAfterLast, NULL,
+			&memory), URI_SUCCESS);
+	ASSERT_EQ(uriAddBaseUriExMmA(&resolved, &uri, &base,
+			URI_RESOLVE_STRICTLY, &memory), URI_SUCCESS);
+	ASSERT_EQ(uriMakeOwnerMmA(&resolved, &memory), URI_SUCCESS);
+	ASSERT_EQ(uriFreeUriMembersMmA(&resolved, &memory), URI_SUCCESS);
+	ASSERT_EQ(uriFreeUriMembersMmA(&uri, &memory), URI_SUCCESS);
+	ASSERT_EQ(uriFreeUriMembersMmA(&base, &memory), URI_SUCCESS);
+
+	EXPECT_EQ(sized.callCountMismatch, 0U);
+	EXPECT_TRUE(sized.live.empty());
+	EXPECT_GT(sized.callCountByKind[URI_MEMORY_PATH_SEGMENT], 0U);
+	EXPECT_GT(sized.callCountByKind[URI_MEMORY_HOST_DATA], 0U);
+	EXPECT_GT(sized.callCountByKind[URI_MEMORY_TEXT], 0U);
+}
+
+
+
+TEST(MemoryManagerSizedSuite, QueryListLifecycle) {
+	UriMemoryManager memory;
+	CheckingSizedBackend sized;
+	UriQueryListA * queryList;
+	int itemCount;
+	char * composed;
+	const char * const first = "k1=v1&k2&k3=%20";
+	const char * const afterLast = first + strlen(first);
+
+	ASSERT_EQ(uriCompleteSizedMemoryManager(&memory, &sized.backend),
+			URI_SUCCESS);
+
+	ASSERT_EQ(uriDissectQueryMallocExMmA(&queryList, &itemCount, first,
+			afterLast, URI_TRUE, URI_BR_DONT_TOUCH, &memory), URI_SUCCESS);
+	ASSERT_EQ(itemCount, 3);
+	ASSERT_EQ(uriComposeQueryMallocExMmA(&composed, queryList, URI_TRUE,
+			URI_TRUE, &memory), URI_SUCCESS);
+	memory.free(&memory, composed);
+	ASSERT_EQ(uriFreeQueryListMmA(queryList, &memory), URI_SUCCESS);
+
+	EXPECT_EQ(sized.callCountMismatch, 0U);
+	EXPECT_TRUE(sized.live.empty());
+	EXPECT_EQ(sized.callCountByKind[URI_MEMORY_QUERY_LIST], 3U);
+}
+
+
+
 TEST(FailingMemoryManagerSuite, AddBaseUriExMm) {
 	UriUriA absoluteDest;
 	UriUriA relativeSource = parse("foo");
@@ -338,6 +602,67 @@ TEST(FailingMemoryManagerSuite, DissectQueryMallocExMm) {
 
 
 
+TEST(FailingMemoryManagerSuite, DissectQueryArrayMallocExMm) {
+	UriQueryListA * queryList;
+	int itemCount;
+	const char * const first = "k1=v1&k2=v2";
+	const char * const afterLast = first + strlen(first);
+	const UriBool plusToSpace = URI_TRUE;  // not of interest
+	const UriBreakConversion breakConversion = URI_BR_DONT_TOUCH;  // not o. i.
+	FailingMemoryManager failingMemoryManager;
+
+	ASSERT_EQ(uriDissectQueryArrayMallocExMmA(&queryList, &itemCount,
+			first, afterLast, plusToSpace, breakConversion,
+			&failingMemoryManager),
+			URI_ERROR_MALLOC);
+	ASSERT_EQ(failingMemoryManager.getCallCountFree(), 0U);
+}
+
+
+
+namespace {
+	int ignoreQueryItem(void * /*userData*/, const char * /*key*/,
+			const char * /*value*/) {
+		return 0;
+	}
+}  // namespace
+
+TEST(FailingMemoryManagerSuite, QueryDecoderFeed) {
+	UriQueryDecoderA decoder;
+	const char * const first = "k1=v1&k2=v2";
+	const char * const afterLast = first + strlen(first);
+	const UriBool plusToSpace = URI_TRUE;  // not of interest
+	const UriBreakConversion breakConversion = URI_BR_DONT_TOUCH;  // not o. i.
+	FailingMemoryManager failingMemoryManager;
+
+	ASSERT_EQ(uriQueryDecoderInitMmA(&decoder, ignoreQueryItem, NULL,
+			plusToSpace, breakConversion, &failingMemoryManager),
+			URI_SUCCESS);
+	ASSERT_EQ(uriQueryDecoderFeedA(&decoder, first, afterLast),
+			URI_ERROR_MALLOC);
+	ASSERT_EQ(uriQueryDecoderFeedA(&decoder, first, afterLast),
+			URI_ERROR_MALLOC);
+	ASSERT_EQ(uriQueryDecoderFinishA(&decoder), URI_ERROR_MALLOC);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, QueryBuilderAppend) {
+	UriQueryBuilderA builder;
+	const UriBool spaceToPlus = URI_TRUE;  // not of interest
+	const UriBool normalizeBreaks = URI_TRUE;  // not of interest
+	FailingMemoryManager failingMemoryManager;
+
+	ASSERT_EQ(uriQueryBuilderInitMmA(&builder, spaceToPlus, normalizeBreaks,
+			&failingMemoryManager), URI_SUCCESS);
+	ASSERT_EQ(uriQueryBuilderAppendA(&builder, "k1", NULL, "v1", NULL),
+			URI_ERROR_MALLOC);
+	ASSERT_EQ(builder.itemCount, 0U);
+	ASSERT_EQ(uriQueryBuilderFreeA(&builder), URI_SUCCESS);
+}
+
+
+
 TEST(FailingMemoryManagerSuite, FreeQueryListMm) {
 	UriQueryListA * const queryList = parseQueryList("k1=v1");
 	FailingMemoryManager failingMemoryManager;
@@ -373,6 +698,7 @@ namespace {
 				  URI_ERROR_MALLOC);
 
 		EXPECT_EQ(failingMemoryManager.getCallCountFree(), expectedCallCountFree);
+		EXPECT_EQ(uri.owner, URI_FALSE);
 
 		uriFreeUriMembersA(&uri);
 	}
@@ -399,19 +725,137 @@ TEST(FailingMemoryManagerSuite, NormalizeSyntaxExMmEmptyFragment) {
 }
 
 TEST(FailingMemoryManagerSuite, NormalizeSyntaxExMmHostTextIp4) {  // issue #121
-	testNormalizeSyntaxWithFailingMallocCallsFreeTimes("//192.0.2.0:123" /* RFC 5737 */, URI_NORMALIZE_HOST, 1, 1);
+	testNormalizeSyntaxWithFailingMallocCallsFreeTimes("//192.0.2.0:123" /* RFC 5737 */, URI_NORMALIZE_HOST);
 }
 
 TEST(FailingMemoryManagerSuite, NormalizeSyntaxExMmHostTextIp6) {  // issue #121
-	testNormalizeSyntaxWithFailingMallocCallsFreeTimes("//[2001:db8::]:123" /* RFC 3849 */, URI_NORMALIZE_HOST, 1, 1);
+	testNormalizeSyntaxWithFailingMallocCallsFreeTimes("//[2001:db8::]:123" /* RFC 3849 */, URI_NORMALIZE_HOST);
 }
 
 TEST(FailingMemoryManagerSuite, NormalizeSyntaxExMmHostTextRegname) {  // issue #121
-	testNormalizeSyntaxWithFailingMallocCallsFreeTimes("//host123.test:123" /* RFC 6761 */, URI_NORMALIZE_HOST, 1, 1);
+	testNormalizeSyntaxWithFailingMallocCallsFreeTimes("//host123.test:123" /* RFC 6761 */, URI_NORMALIZE_HOST);
 }
 
 TEST(FailingMemoryManagerSuite, NormalizeSyntaxExMmHostTextFuture) {  // issue #121
-	testNormalizeSyntaxWithFailingMallocCallsFreeTimes("//[v7.X]:123" /* arbitrary IPvFuture */, URI_NORMALIZE_HOST, 1, 1);
+	testNormalizeSyntaxWithFailingMallocCallsFreeTimes("//[v7.X]:123" /* arbitrary IPvFuture */, URI_NORMALIZE_HOST);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, NormalizeSyntaxExMmSingleAllocation) {
+	UriUriA uri = parse("HTTP://%7eUser@Example.ORG:80/1/2/3/4/5/6/7/8/9/%7e10?%7eq#%7ef");
+	FailingMemoryManager failingMemoryManager(1);
+
+	ASSERT_EQ(uriNormalizeSyntaxExMmA(&uri, (unsigned int)-1, &failingMemoryManager),
+			URI_SUCCESS);
+	ASSERT_EQ(uri.owner, URI_TRUE);
+	EXPECT_EQ(failingMemoryManager.getCallCountFree(), 0U);
+
+	uriFreeUriMembersMmA(&uri, &failingMemoryManager);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, CopyUriMmSingleAllocation) {
+	UriUriA source = parse("http://user@[::1]:80/1/2/3/4/5/6/7/8/9/10?q#f");
+	UriUriA copy;
+	FailingMemoryManager failingMemoryManager(1);
+
+	ASSERT_EQ(uriCopyUriMmA(&copy, &source, &failingMemoryManager),
+			URI_SUCCESS);
+	uriFreeUriMembersA(&source);
+
+	ASSERT_EQ(uriFreeUriMembersMmA(&copy, &failingMemoryManager), URI_SUCCESS);
+	EXPECT_EQ(failingMemoryManager.getCallCountFree(), 1U);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, CopyUriMm) {
+	UriUriA source = parse("http://example.org/a/b/c/");
+	UriUriA copy;
+	FailingMemoryManager failingMemoryManager;
+
+	ASSERT_EQ(uriCopyUriMmA(&copy, &source, &failingMemoryManager),
+			URI_ERROR_MALLOC);
+
+	uriFreeUriMembersA(&source);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, FreezeUriMmSingleAllocation) {
+	UriUriA source = parse("http://1.2.3.4/1/2/3/4/5/6/7/8/9/10?q#f");
+	const UriFrozenUriA * frozen = NULL;
+	FailingMemoryManager failingMemoryManager(1);
+
+	ASSERT_EQ(uriFreezeUriMmA(&frozen, &source, &failingMemoryManager),
+			URI_SUCCESS);
+	uriFreeUriMembersA(&source);
+
+	uriFrozenUriRetainA(frozen);
+	ASSERT_EQ(uriFrozenUriReleaseMmA(frozen, &failingMemoryManager), URI_SUCCESS);
+	EXPECT_EQ(failingMemoryManager.getCallCountFree(), 0U);
+	ASSERT_EQ(uriFrozenUriReleaseMmA(frozen, &failingMemoryManager), URI_SUCCESS);
+	EXPECT_EQ(failingMemoryManager.getCallCountFree(), 1U);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, FreezeUriMm) {
+	UriUriA source = parse("http://example.org/a/b/c/");
+	const UriFrozenUriA * frozen = NULL;
+	FailingMemoryManager failingMemoryManager;
+
+	ASSERT_EQ(uriFreezeUriMmA(&frozen, &source, &failingMemoryManager),
+			URI_ERROR_MALLOC);
+	EXPECT_TRUE(frozen == NULL);
+
+	uriFreeUriMembersA(&source);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, MakeOwnerMmSingleAllocation) {
+	UriUriA uri = parse("http://user@example.org:8080/1/2/3/4/5/6/7/8/9/10?q#f");
+	FailingMemoryManager failingMemoryManager(1);
+
+	ASSERT_EQ(uriMakeOwnerMmA(&uri, &failingMemoryManager), URI_SUCCESS);
+	ASSERT_EQ(uri.owner, URI_TRUE);
+
+	uriFreeUriMembersA(&uri);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, MakeOwnerMm) {
+	UriUriA uri = parse("http://example.org/a/b/c/");
+	FailingMemoryManager failingMemoryManager;
+
+	ASSERT_EQ(uriMakeOwnerMmA(&uri, &failingMemoryManager), URI_ERROR_MALLOC);
+	ASSERT_EQ(uri.owner, URI_FALSE);
+
+	uriFreeUriMembersA(&uri);
+}
+
+
+
+TEST(FailingMemoryManagerSuite, ToStringMallocExMm) {
+	UriUriA uri = parse("http://example.org/a/b/c/?q#f");
+	char * text = NULL;
+
+	FailingMemoryManager failingMemoryManager;
+	ASSERT_EQ(uriToStringMallocExMmA(&text, &uri, URI_NORMALIZED, NULL,
+			&failingMemoryManager), URI_ERROR_MALLOC);
+	EXPECT_TRUE(text == NULL);
+
+	FailingMemoryManager singleAllocationMemoryManager(1);
+	ASSERT_EQ(uriToStringMallocExMmA(&text, &uri, URI_NORMALIZED, NULL,
+			&singleAllocationMemoryManager), URI_SUCCESS);
+	EXPECT_STREQ(text, "http://example.org/a/b/c/?q#f");
+	free(text);
+
+	uriFreeUriMembersA(&uri);
 }
 
 